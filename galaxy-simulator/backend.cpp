@@ -0,0 +1,190 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "backend.h"
+#include "host_backend.h"
+#include "utils.h"
+#ifndef HEADLESS
+#include "ocl_backend.h"
+#endif
+#include <CL/cl_half.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+std::unique_ptr<Backend> Backend::create(Kind kind, GLsizei num, Precision precision, Packing packing)
+{
+	switch (kind)
+	{
+#ifndef HEADLESS
+	case Kind::OPENCL_GPU:
+		return std::make_unique<Ocl_backend>(num, false, precision, packing);
+
+	case Kind::OPENCL_CPU:
+		return std::make_unique<Ocl_backend>(num, true, precision, packing);
+#endif
+
+	case Kind::HOST_TREE:
+		return std::make_unique<Host_backend>(num, true, precision, packing);
+
+	default:
+		return std::make_unique<Host_backend>(num, false, precision, packing);
+	}
+}
+
+
+const char* Backend::name(Kind kind)
+{
+	switch (kind)
+	{
+	case Kind::OPENCL_GPU:
+		return "opencl-gpu";
+
+	case Kind::OPENCL_CPU:
+		return "opencl-cpu";
+
+	case Kind::HOST_TREE:
+		return "host-tree";
+
+	default:
+		return "host-simd";
+	}
+}
+
+
+const char* Backend::name(Precision precision)
+{
+	switch (precision)
+	{
+	case Precision::MIXED:
+		return "mixed";
+
+	case Precision::DOUBLE:
+		return "double";
+
+	default:
+		return "float";
+	}
+}
+
+
+const char* Backend::name(Packing packing)
+{
+	switch (packing)
+	{
+	case Packing::HALF:
+		return "half";
+
+	case Packing::SNORM16:
+		return "snorm16";
+
+	default:
+		return "float";
+	}
+}
+
+
+bool Backend::same_forces(const Settings& a, const Settings& b)
+{
+	// accelerations kept from the last step are only reusable if they would come out the same
+	return (a.solver == b.solver) && (a.accumulation == b.accumulation) && (a.opening_angle == b.opening_angle) &&
+		(a.quadrupole == b.quadrupole) && (a.fmm_order == b.fmm_order) && (a.pm_grid == b.pm_grid) &&
+		(a.tree_pm_split == b.tree_pm_split) && (a.tree_pm_cutoff == b.tree_pm_cutoff) &&
+		(a.mass == b.mass) && (a.radius == b.radius) && (a.repulsion == b.repulsion);
+}
+
+
+size_t Backend::packed_size(Packing packing)
+{
+	return (packing == Packing::FLOAT) ? sizeof(Vector4D) : 4 * sizeof(cl_short);
+}
+
+
+void Backend::pack(Packing packing, const Vector4D* pos, size_t num, void* dst)
+{
+	switch (packing)
+	{
+	case Packing::HALF:
+	{
+		cl_half* half = static_cast<cl_half*>(dst);
+
+		Utils::parallel_for(num, 4096, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				half[4 * i + 0] = cl_half_from_float(pos[i].x, CL_HALF_RTE);
+				half[4 * i + 1] = cl_half_from_float(pos[i].y, CL_HALF_RTE);
+				half[4 * i + 2] = cl_half_from_float(pos[i].z, CL_HALF_RTE);
+				half[4 * i + 3] = cl_half_from_float(pos[i].w, CL_HALF_RTE);
+			}
+		});
+
+		break;
+	}
+
+	case Packing::SNORM16:
+	{
+		// the stars stay inside the unit sphere, so x, y and z map onto the full short range and w stays 1
+		cl_short* snorm = static_cast<cl_short*>(dst);
+
+		Utils::parallel_for(num, 4096, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				snorm[4 * i + 0] = static_cast<cl_short>(std::lround(std::min(std::max(pos[i].x, -1.0f), 1.0f) * snorm16_scale));
+				snorm[4 * i + 1] = static_cast<cl_short>(std::lround(std::min(std::max(pos[i].y, -1.0f), 1.0f) * snorm16_scale));
+				snorm[4 * i + 2] = static_cast<cl_short>(std::lround(std::min(std::max(pos[i].z, -1.0f), 1.0f) * snorm16_scale));
+				snorm[4 * i + 3] = 1;
+			}
+		});
+
+		break;
+	}
+
+	default:
+		std::memcpy(dst, pos, num * sizeof(Vector4D));
+		break;
+	}
+}
+
+
+void Backend::finish()
+{
+}
+
+
+bool Backend::shares_gl() const
+{
+	return false;
+}
+
+
+unsigned Backend::get_reorder_count() const
+{
+	return 0;
+}
+
+
+double Backend::get_reorder_time() const
+{
+	return 0.0;
+}
+
+
+void Backend::tune(const Settings&, std::ostream& out)
+{
+	out << name(kind()) << " has nothing to tune" << std::endl;
+}
@@ -0,0 +1,84 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <memory>
+#include <ostream>
+#include "opengl.h"
+#include "settings.h"
+#include "vector4d.h"
+
+class Backend
+{
+public:
+	enum class Kind
+	{
+		OPENCL_GPU,
+		OPENCL_CPU,
+		HOST_SIMD,
+		HOST_TREE
+	};
+
+	static const int num_kinds = 4;
+
+	enum class Precision
+	{
+		FLOAT,
+		MIXED,
+		DOUBLE
+	};
+
+	static const int num_precisions = 3;
+
+	enum class Packing
+	{
+		FLOAT,
+		HALF,
+		SNORM16
+	};
+
+	static const int num_packings = 3;
+	static constexpr float snorm16_scale = 32767.0f;
+
+	static std::unique_ptr<Backend> create(Kind kind, GLsizei num, Precision precision, Packing packing);
+	static const char* name(Kind kind);
+	static const char* name(Precision precision);
+	static const char* name(Packing packing);
+	static size_t packed_size(Packing packing);
+	static void pack(Packing packing, const Vector4D* pos, size_t num, void* dst);
+
+	virtual ~Backend() = default;
+
+	virtual bool init(const Settings& settings, const GLuint* vbos, size_t num_vbos, const Vector4D* pos, const Vector4D* vel) = 0;
+	virtual void step(const Settings& settings, unsigned steps) = 0;
+	virtual void accelerations(const Settings& settings, Vector4D* acc) = 0;
+	virtual void map_positions(size_t slot) = 0;
+	virtual void positions(Vector4D* pos) = 0;
+	virtual void state(Vector4D* pos, Vector4D* vel) = 0;
+	virtual void release() = 0;
+
+	virtual Kind kind() const = 0;
+	virtual void finish();
+	virtual bool shares_gl() const;
+	virtual unsigned get_reorder_count() const;
+	virtual double get_reorder_time() const;
+	virtual void tune(const Settings& settings, std::ostream& out);
+
+protected:
+	static bool same_forces(const Settings& a, const Settings& b);
+};
+
+#endif
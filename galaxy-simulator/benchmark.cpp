@@ -0,0 +1,266 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "benchmark.h"
+#include "direct_sum.h"
+#include "utils.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <random>
+
+
+double Benchmark::time_accelerations(Stars& stars, Vector4D* acc, unsigned repeats)
+{
+	stars.accelerations(acc);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < repeats; i++)
+	{
+		stars.accelerations(acc);
+	}
+
+	const auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(stop - start).count() / repeats;
+}
+
+
+double Benchmark::error(const Vector4D* acc, const Vector4D* ref, size_t num)
+{
+	double diff = 0.0;
+	double norm = 0.0;
+
+	for (size_t i = 0; i < num; i++)
+	{
+		const double dx = acc[i].x - ref[i].x;
+		const double dy = acc[i].y - ref[i].y;
+		const double dz = acc[i].z - ref[i].z;
+
+		diff += dx * dx + dy * dy + dz * dz;
+		norm += ref[i].x * ref[i].x + ref[i].y * ref[i].y + ref[i].z * ref[i].z;
+	}
+
+	return (norm > 0.0) ? std::sqrt(diff / norm) : std::sqrt(diff);
+}
+
+
+double Benchmark::run(GLulong num, const Settings& settings, float duration, Vector4D* pos)
+{
+	const unsigned seed = 1;
+	const unsigned steps = static_cast<unsigned>(duration / settings.time_step + 0.5f);
+
+	Stars stars(num, seed);
+	stars.init();
+	stars.set_settings(settings);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	stars.calculate(steps);
+	stars.finish();
+
+	const auto stop = std::chrono::steady_clock::now();
+
+	stars.positions(pos);
+	return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+
+void Benchmark::reference(const Vector4D* pos, size_t num, const Settings& settings, Vector4D* acc)
+{
+	Utils::parallel_for(num, 64, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			double sum[3] = { 0.0, 0.0, 0.0 };
+
+			for (size_t j = 0; j < num; j++)
+			{
+				const double d[3] = { static_cast<double>(pos[j].x) - pos[i].x,
+					static_cast<double>(pos[j].y) - pos[i].y, static_cast<double>(pos[j].z) - pos[i].z };
+				const double r = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+				const double coef = (r > settings.radius) ? (settings.mass / (r * r * r)) : -settings.repulsion;
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					sum[k] += coef * d[k];
+				}
+			}
+
+			acc[i] = { static_cast<float>(sum[0]), static_cast<float>(sum[1]), static_cast<float>(sum[2]), 0.0f };
+		}
+	});
+}
+
+
+void Benchmark::fmm_orders(GLulong num, std::ostream& out)
+{
+	const unsigned repeats = 3;
+	const int max_order = 10;
+
+	Stars stars(num);
+	stars.init();
+
+	const size_t count = stars.get_num();
+	auto ref = std::make_unique<Vector4D[]>(count);
+	auto acc = std::make_unique<Vector4D[]>(count);
+
+	Settings settings = stars.get_settings();
+	settings.solver = Settings::Solver::DIRECT;
+	stars.set_settings(settings);
+
+	const double direct_time = time_accelerations(stars, ref.get(), repeats);
+
+	out << "FMM accuracy vs. expansion order, " << count << " stars" << std::endl;
+	out << std::setw(8) << "order" << std::setw(14) << "time [ms]" << std::setw(16) << "rms rel. error" << std::endl;
+	out << std::setw(8) << "direct" << std::setw(14) << std::fixed << std::setprecision(3) << direct_time
+		<< std::setw(16) << std::scientific << std::setprecision(3) << 0.0 << std::endl;
+
+	settings.solver = Settings::Solver::FMM;
+
+	for (int order = 1; order <= max_order; order++)
+	{
+		settings.fmm_order = order;
+		stars.set_settings(settings);
+
+		const double time = time_accelerations(stars, acc.get(), repeats);
+
+		out << std::setw(8) << order << std::setw(14) << std::fixed << std::setprecision(3) << time
+			<< std::setw(16) << std::scientific << std::setprecision(3) << error(acc.get(), ref.get(), count) << std::endl;
+	}
+}
+
+
+void Benchmark::integrators(GLulong num, std::ostream& out)
+{
+	const float duration = 0.32f;
+	const float time_steps[] = { 0.02f, 0.01f, 0.005f, 0.0025f };
+
+	const Settings::Integrator integrators[] = { Settings::Integrator::EULER, Settings::Integrator::LEAPFROG, Settings::Integrator::HERMITE };
+	const char* names[] = { "euler", "leapfrog", "hermite" };
+
+	const size_t count = (num < 2) ? 2 : num;
+	auto ref = std::make_unique<Vector4D[]>(count);
+	auto pos = std::make_unique<Vector4D[]>(count);
+
+	Settings settings;
+	settings.solver = Settings::Solver::DIRECT;
+	settings.integrator = Settings::Integrator::HERMITE;
+	settings.time_step = 0.000625f;
+
+	run(num, settings, duration, ref.get());
+
+	out << "Integrator accuracy vs. time step, " << count << " stars, t = " << duration << std::endl;
+	out << std::setw(10) << "scheme" << std::setw(12) << "time step" << std::setw(14) << "time [ms]"
+		<< std::setw(16) << "rms rel. error" << std::endl;
+
+	for (size_t n = 0; n < sizeof(integrators) / sizeof(integrators[0]); n++)
+	{
+		settings.integrator = integrators[n];
+
+		for (float time_step : time_steps)
+		{
+			settings.time_step = time_step;
+
+			const double time = run(num, settings, duration, pos.get());
+
+			out << std::setw(10) << names[n] << std::setw(12) << std::fixed << std::setprecision(4) << time_step
+				<< std::setw(14) << std::setprecision(3) << time
+				<< std::setw(16) << std::scientific << std::setprecision(3) << error(pos.get(), ref.get(), count) << std::endl;
+		}
+	}
+}
+
+
+void Benchmark::simd(size_t num, std::ostream& out)
+{
+	const unsigned repeats = 3;
+
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<float> distrib_pos(-0.5f, 0.5f);
+
+	auto pos = std::make_unique<Vector4D[]>(num);
+	auto ref = std::make_unique<Vector4D[]>(num);
+	auto acc = std::make_unique<Vector4D[]>(num);
+
+	for (size_t i = 0; i < num; i++)
+	{
+		pos[i] = { distrib_pos(gen), distrib_pos(gen), 0.1f * distrib_pos(gen), 1.0f };
+	}
+
+	const Settings settings;
+	Direct_sum direct_sum;
+
+	out << "Host direct sum per instruction set, " << num << " stars" << std::endl;
+	out << std::setw(8) << "isa" << std::setw(14) << "time [ms]" << std::setw(16) << "rms rel. error" << std::endl;
+
+	for (int isa = 0; isa <= static_cast<int>(Direct_sum::best_isa()); isa++)
+	{
+		direct_sum.set_isa(static_cast<Direct_sum::Isa>(isa));
+		Vector4D* result = (isa == 0) ? ref.get() : acc.get();
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned r = 0; r < repeats; r++)
+		{
+			direct_sum.accelerations(pos.get(), num, settings, result);
+		}
+
+		const auto stop = std::chrono::steady_clock::now();
+		const double time = std::chrono::duration<double, std::milli>(stop - start).count() / repeats;
+
+		out << std::setw(8) << Direct_sum::isa_name(direct_sum.get_isa()) << std::setw(14) << std::fixed << std::setprecision(3) << time
+			<< std::setw(16) << std::scientific << std::setprecision(3) << error(result, ref.get(), num) << std::endl;
+	}
+}
+
+
+void Benchmark::accumulation(GLulong num, std::ostream& out)
+{
+	const unsigned repeats = 3;
+
+	const Settings::Accumulation accumulations[] = { Settings::Accumulation::FLOAT, Settings::Accumulation::KAHAN, Settings::Accumulation::DOUBLE };
+	const char* names[] = { "float", "kahan", "double" };
+
+	Stars stars(num, 1);
+	stars.init();
+
+	const size_t count = stars.get_num();
+	auto pos = std::make_unique<Vector4D[]>(count);
+	auto ref = std::make_unique<Vector4D[]>(count);
+	auto acc = std::make_unique<Vector4D[]>(count);
+
+	Settings settings = stars.get_settings();
+	settings.solver = Settings::Solver::DIRECT;
+
+	stars.positions(pos.get());
+	reference(pos.get(), count, settings, ref.get());
+
+	out << "Force accumulation precision on " << Backend::name(stars.get_backend()) << ", " << count << " stars" << std::endl;
+	out << std::setw(8) << "mode" << std::setw(14) << "time [ms]" << std::setw(16) << "rms rel. error" << std::endl;
+
+	for (size_t n = 0; n < sizeof(accumulations) / sizeof(accumulations[0]); n++)
+	{
+		settings.accumulation = accumulations[n];
+		stars.set_settings(settings);
+
+		const double time = time_accelerations(stars, acc.get(), repeats);
+
+		out << std::setw(8) << names[n] << std::setw(14) << std::fixed << std::setprecision(3) << time
+			<< std::setw(16) << std::scientific << std::setprecision(3) << error(acc.get(), ref.get(), count) << std::endl;
+	}
+}
@@ -0,0 +1,41 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "stars.h"
+#include "vector4d.h"
+#include <cstddef>
+#include <ostream>
+
+class Benchmark
+{
+private:
+	Benchmark() = delete;
+	~Benchmark() = delete;
+
+	static double time_accelerations(Stars& stars, Vector4D* acc, unsigned repeats);
+	static double error(const Vector4D* acc, const Vector4D* ref, size_t num);
+	static double run(GLulong num, const Settings& settings, float duration, Vector4D* pos);
+	static void reference(const Vector4D* pos, size_t num, const Settings& settings, Vector4D* acc);
+
+public:
+	static void fmm_orders(GLulong num, std::ostream& out);
+	static void integrators(GLulong num, std::ostream& out);
+	static void simd(size_t num, std::ostream& out);
+	static void accumulation(GLulong num, std::ostream& out);
+};
+
+#endif
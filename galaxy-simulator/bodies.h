@@ -0,0 +1,87 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BODIES_H
+#define BODIES_H
+
+#include "particles.h"
+#include "vector4d.h"
+#include <cstddef>
+
+// positions and accelerations of the host solvers, either interleaved or the integrator's separate arrays read in place
+class Bodies
+{
+private:
+	const Vector4D* m_pos;
+	Vector4D* m_acc;
+	const float* m_x;
+	const float* m_y;
+	const float* m_z;
+	float* m_ax;
+	float* m_ay;
+	float* m_az;
+
+public:
+	Bodies(const Vector4D* pos, Vector4D* acc) :
+		m_pos(pos), m_acc(acc), m_x(nullptr), m_y(nullptr), m_z(nullptr), m_ax(nullptr), m_ay(nullptr), m_az(nullptr)
+	{
+	}
+
+	Bodies(Particles& particles) :
+		m_pos(nullptr), m_acc(nullptr), m_x(particles.x()), m_y(particles.y()), m_z(particles.z()),
+		m_ax(particles.ax()), m_ay(particles.ay()), m_az(particles.az())
+	{
+	}
+
+	// null when the positions are interleaved
+	const float* x() const { return m_x; }
+	const float* y() const { return m_y; }
+	const float* z() const { return m_z; }
+
+	inline Vector4D position(size_t i) const
+	{
+		if (m_pos) return m_pos[i];
+		return { m_x[i], m_y[i], m_z[i], 0.0f };
+	}
+
+	inline void set_acceleration(size_t i, const Vector4D& acc) const
+	{
+		if (m_acc)
+		{
+			m_acc[i] = acc;
+			return;
+		}
+
+		m_ax[i] = acc.x;
+		m_ay[i] = acc.y;
+		m_az[i] = acc.z;
+	}
+
+	inline void add_acceleration(size_t i, const Vector4D& acc) const
+	{
+		if (m_acc)
+		{
+			m_acc[i].x += acc.x;
+			m_acc[i].y += acc.y;
+			m_acc[i].z += acc.z;
+			return;
+		}
+
+		m_ax[i] += acc.x;
+		m_ay[i] += acc.y;
+		m_az[i] += acc.z;
+	}
+};
+
+#endif
@@ -0,0 +1,494 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "direct_sum.h"
+#include "gravity.h"
+#include "utils.h"
+#include <cmath>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+
+Direct_sum::Direct_sum() :
+	m_isa(best_isa())
+{
+}
+
+
+Direct_sum::Isa Direct_sum::best_isa()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return Isa::SCALAR;
+
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool fma = (info[2] & (1 << 12)) != 0;
+	if (!osxsave) return Isa::SCALAR;
+
+	const unsigned long long xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x6) != 0x6) return Isa::SCALAR;
+
+	__cpuidex(info, 7, 0);
+	const bool avx2 = (info[1] & (1 << 5)) != 0;
+	const bool avx512f = (info[1] & (1 << 16)) != 0;
+
+	if (avx512f && ((xcr0 & 0xe6) == 0xe6)) return Isa::AVX512;
+	if (avx2 && fma) return Isa::AVX2;
+	return Isa::SCALAR;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Isa::AVX2;
+	return Isa::SCALAR;
+#endif
+}
+
+
+const char* Direct_sum::isa_name(Isa isa)
+{
+	switch (isa)
+	{
+	case Isa::AVX2:
+		return "avx2";
+
+	case Isa::AVX512:
+		return "avx512";
+
+	default:
+		return "scalar";
+	}
+}
+
+
+void Direct_sum::set_isa(Isa isa)
+{
+	m_isa = (static_cast<int>(isa) <= static_cast<int>(best_isa())) ? isa : best_isa();
+}
+
+
+Direct_sum::Isa Direct_sum::get_isa() const
+{
+	return m_isa;
+}
+
+
+void Direct_sum::block_scalar(const Vector4D* pos, size_t num, size_t begin, size_t end, const Settings& settings, Vector4D* acc)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		acc[i] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+		for (size_t j = 0; j < num; j++)
+		{
+			Gravity::interaction(pos[i], pos[j], settings, acc[i]);
+		}
+	}
+}
+
+
+SIMD_TARGET("avx2,fma")
+void Direct_sum::block_avx2(const Vector4D* pos, size_t num, size_t begin, size_t end, const Settings& settings, Vector4D* acc)
+{
+	const __m256 mass = _mm256_set1_ps(settings.mass);
+	const __m256 radius = _mm256_set1_ps(settings.radius);
+	const __m256 repulsion = _mm256_set1_ps(-settings.repulsion);
+
+	size_t i = begin;
+
+	for (; i + 8 <= end; i += 8)
+	{
+		const __m256 xi = _mm256_setr_ps(pos[i].x, pos[i + 1].x, pos[i + 2].x, pos[i + 3].x,
+			pos[i + 4].x, pos[i + 5].x, pos[i + 6].x, pos[i + 7].x);
+		const __m256 yi = _mm256_setr_ps(pos[i].y, pos[i + 1].y, pos[i + 2].y, pos[i + 3].y,
+			pos[i + 4].y, pos[i + 5].y, pos[i + 6].y, pos[i + 7].y);
+		const __m256 zi = _mm256_setr_ps(pos[i].z, pos[i + 1].z, pos[i + 2].z, pos[i + 3].z,
+			pos[i + 4].z, pos[i + 5].z, pos[i + 6].z, pos[i + 7].z);
+
+		__m256 ax = _mm256_setzero_ps();
+		__m256 ay = _mm256_setzero_ps();
+		__m256 az = _mm256_setzero_ps();
+
+		for (size_t j = 0; j < num; j++)
+		{
+			const __m256 dx = _mm256_sub_ps(_mm256_broadcast_ss(&pos[j].x), xi);
+			const __m256 dy = _mm256_sub_ps(_mm256_broadcast_ss(&pos[j].y), yi);
+			const __m256 dz = _mm256_sub_ps(_mm256_broadcast_ss(&pos[j].z), zi);
+
+			const __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+			const __m256 r = _mm256_sqrt_ps(r2);
+			const __m256 newton = _mm256_div_ps(mass, _mm256_mul_ps(r2, r));
+			const __m256 coef = _mm256_blendv_ps(repulsion, newton, _mm256_cmp_ps(r, radius, _CMP_GT_OQ));
+
+			ax = _mm256_fmadd_ps(coef, dx, ax);
+			ay = _mm256_fmadd_ps(coef, dy, ay);
+			az = _mm256_fmadd_ps(coef, dz, az);
+		}
+
+		alignas(32) float out[3][8];
+		_mm256_store_ps(out[0], ax);
+		_mm256_store_ps(out[1], ay);
+		_mm256_store_ps(out[2], az);
+
+		for (size_t k = 0; k < 8; k++)
+		{
+			acc[i + k] = { out[0][k], out[1][k], out[2][k], 0.0f };
+		}
+	}
+
+	block_scalar(pos, num, i, end, settings, acc);
+}
+
+
+SIMD_TARGET("avx512f")
+void Direct_sum::block_avx512(const Vector4D* pos, size_t num, size_t begin, size_t end, const Settings& settings, Vector4D* acc)
+{
+	const __m512 mass = _mm512_set1_ps(settings.mass);
+	const __m512 radius = _mm512_set1_ps(settings.radius);
+	const __m512 repulsion = _mm512_set1_ps(-settings.repulsion);
+	const __m512i index = _mm512_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60);
+
+	size_t i = begin;
+
+	for (; i + 16 <= end; i += 16)
+	{
+		const float* base = &pos[i].x;
+		const __m512 xi = _mm512_i32gather_ps(index, base, 4);
+		const __m512 yi = _mm512_i32gather_ps(index, base + 1, 4);
+		const __m512 zi = _mm512_i32gather_ps(index, base + 2, 4);
+
+		__m512 ax = _mm512_setzero_ps();
+		__m512 ay = _mm512_setzero_ps();
+		__m512 az = _mm512_setzero_ps();
+
+		for (size_t j = 0; j < num; j++)
+		{
+			const __m512 dx = _mm512_sub_ps(_mm512_set1_ps(pos[j].x), xi);
+			const __m512 dy = _mm512_sub_ps(_mm512_set1_ps(pos[j].y), yi);
+			const __m512 dz = _mm512_sub_ps(_mm512_set1_ps(pos[j].z), zi);
+
+			const __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+			const __m512 r = _mm512_sqrt_ps(r2);
+			const __m512 newton = _mm512_div_ps(mass, _mm512_mul_ps(r2, r));
+			const __m512 coef = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(r, radius, _CMP_GT_OQ), repulsion, newton);
+
+			ax = _mm512_fmadd_ps(coef, dx, ax);
+			ay = _mm512_fmadd_ps(coef, dy, ay);
+			az = _mm512_fmadd_ps(coef, dz, az);
+		}
+
+		alignas(64) float out[3][16];
+		_mm512_store_ps(out[0], ax);
+		_mm512_store_ps(out[1], ay);
+		_mm512_store_ps(out[2], az);
+
+		for (size_t k = 0; k < 16; k++)
+		{
+			acc[i + k] = { out[0][k], out[1][k], out[2][k], 0.0f };
+		}
+	}
+
+	block_scalar(pos, num, i, end, settings, acc);
+}
+
+
+void Direct_sum::accelerations(const Vector4D* pos, size_t num, const Settings& settings, Vector4D* acc) const
+{
+	const Isa isa = m_isa;
+
+	Utils::parallel_for(num, m_block, [&](size_t begin, size_t end)
+	{
+		switch (isa)
+		{
+		case Isa::AVX512:
+			block_avx512(pos, num, begin, end, settings, acc);
+			break;
+
+		case Isa::AVX2:
+			block_avx2(pos, num, begin, end, settings, acc);
+			break;
+
+		default:
+			block_scalar(pos, num, begin, end, settings, acc);
+			break;
+		}
+	});
+}
+
+
+void Direct_sum::soa_scalar(Particles& particles, size_t begin, size_t end, const Settings& settings)
+{
+	const size_t num = particles.size();
+	const float* x = particles.x();
+	const float* y = particles.y();
+	const float* z = particles.z();
+	const float* mass = particles.mass();
+
+	for (size_t i = begin; (i < end) && (i < num); i++)
+	{
+		float ax = 0.0f;
+		float ay = 0.0f;
+		float az = 0.0f;
+
+		for (size_t j = 0; j < num; j++)
+		{
+			const float dx = x[j] - x[i];
+			const float dy = y[j] - y[i];
+			const float dz = z[j] - z[i];
+			const float r = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+			const float coef = (r > settings.radius) ? (mass[j] / r / r / r) : -settings.repulsion;
+
+			ax += coef * dx;
+			ay += coef * dy;
+			az += coef * dz;
+		}
+
+		particles.ax()[i] = ax;
+		particles.ay()[i] = ay;
+		particles.az()[i] = az;
+	}
+}
+
+
+SIMD_TARGET("avx2,fma")
+void Direct_sum::soa_avx2(Particles& particles, size_t begin, size_t end, const Settings& settings)
+{
+	const size_t num = particles.size();
+	const float* x = particles.x();
+	const float* y = particles.y();
+	const float* z = particles.z();
+	const float* mass = particles.mass();
+
+	const __m256 radius = _mm256_set1_ps(settings.radius);
+	const __m256 repulsion = _mm256_set1_ps(-settings.repulsion);
+
+	for (size_t i = begin; i < end; i += 8)
+	{
+		const __m256 xi = _mm256_load_ps(x + i);
+		const __m256 yi = _mm256_load_ps(y + i);
+		const __m256 zi = _mm256_load_ps(z + i);
+
+		__m256 ax = _mm256_setzero_ps();
+		__m256 ay = _mm256_setzero_ps();
+		__m256 az = _mm256_setzero_ps();
+
+		for (size_t j = 0; j < num; j++)
+		{
+			const __m256 dx = _mm256_sub_ps(_mm256_broadcast_ss(x + j), xi);
+			const __m256 dy = _mm256_sub_ps(_mm256_broadcast_ss(y + j), yi);
+			const __m256 dz = _mm256_sub_ps(_mm256_broadcast_ss(z + j), zi);
+
+			const __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+			const __m256 r = _mm256_sqrt_ps(r2);
+			const __m256 newton = _mm256_div_ps(_mm256_broadcast_ss(mass + j), _mm256_mul_ps(r2, r));
+			const __m256 coef = _mm256_blendv_ps(repulsion, newton, _mm256_cmp_ps(r, radius, _CMP_GT_OQ));
+
+			ax = _mm256_fmadd_ps(coef, dx, ax);
+			ay = _mm256_fmadd_ps(coef, dy, ay);
+			az = _mm256_fmadd_ps(coef, dz, az);
+		}
+
+		_mm256_store_ps(particles.ax() + i, ax);
+		_mm256_store_ps(particles.ay() + i, ay);
+		_mm256_store_ps(particles.az() + i, az);
+	}
+}
+
+
+SIMD_TARGET("avx512f")
+void Direct_sum::soa_avx512(Particles& particles, size_t begin, size_t end, const Settings& settings)
+{
+	const size_t num = particles.size();
+	const float* x = particles.x();
+	const float* y = particles.y();
+	const float* z = particles.z();
+	const float* mass = particles.mass();
+
+	const __m512 radius = _mm512_set1_ps(settings.radius);
+	const __m512 repulsion = _mm512_set1_ps(-settings.repulsion);
+
+	for (size_t i = begin; i < end; i += 16)
+	{
+		const __m512 xi = _mm512_load_ps(x + i);
+		const __m512 yi = _mm512_load_ps(y + i);
+		const __m512 zi = _mm512_load_ps(z + i);
+
+		__m512 ax = _mm512_setzero_ps();
+		__m512 ay = _mm512_setzero_ps();
+		__m512 az = _mm512_setzero_ps();
+
+		for (size_t j = 0; j < num; j++)
+		{
+			const __m512 dx = _mm512_sub_ps(_mm512_set1_ps(x[j]), xi);
+			const __m512 dy = _mm512_sub_ps(_mm512_set1_ps(y[j]), yi);
+			const __m512 dz = _mm512_sub_ps(_mm512_set1_ps(z[j]), zi);
+
+			const __m512 r2 = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+			const __m512 r = _mm512_sqrt_ps(r2);
+			const __m512 newton = _mm512_div_ps(_mm512_set1_ps(mass[j]), _mm512_mul_ps(r2, r));
+			const __m512 coef = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(r, radius, _CMP_GT_OQ), repulsion, newton);
+
+			ax = _mm512_fmadd_ps(coef, dx, ax);
+			ay = _mm512_fmadd_ps(coef, dy, ay);
+			az = _mm512_fmadd_ps(coef, dz, az);
+		}
+
+		_mm512_store_ps(particles.ax() + i, ax);
+		_mm512_store_ps(particles.ay() + i, ay);
+		_mm512_store_ps(particles.az() + i, az);
+	}
+}
+
+
+void Direct_sum::soa_compensated(Particles& particles, size_t begin, size_t end, const Settings& settings)
+{
+	const size_t num = particles.size();
+	const float* x = particles.x();
+	const float* y = particles.y();
+	const float* z = particles.z();
+	const float* mass = particles.mass();
+	const bool kahan = (settings.accumulation == Settings::Accumulation::KAHAN);
+
+	for (size_t i = begin; (i < end) && (i < num); i++)
+	{
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		float acc[3] = { 0.0f, 0.0f, 0.0f };
+		float comp[3] = { 0.0f, 0.0f, 0.0f };
+
+		for (size_t j = 0; j < num; j++)
+		{
+			const float d[3] = { x[j] - x[i], y[j] - y[i], z[j] - z[i] };
+			const float r = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+			const float coef = (r > settings.radius) ? (mass[j] / r / r / r) : -settings.repulsion;
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				if (kahan)
+				{
+					const float term = coef * d[k] - comp[k];
+					const float total = acc[k] + term;
+					comp[k] = (total - acc[k]) - term;
+					acc[k] = total;
+				}
+				else
+				{
+					sum[k] += coef * d[k];
+				}
+			}
+		}
+
+		particles.ax()[i] = kahan ? acc[0] : static_cast<float>(sum[0]);
+		particles.ay()[i] = kahan ? acc[1] : static_cast<float>(sum[1]);
+		particles.az()[i] = kahan ? acc[2] : static_cast<float>(sum[2]);
+	}
+}
+
+
+void Direct_sum::soa_jerk(Particles& particles, size_t begin, size_t end, const Settings& settings, float* const* jerk)
+{
+	const size_t num = particles.size();
+	const float* pos[3] = { particles.x(), particles.y(), particles.z() };
+	const float* vel[3] = { particles.vx(), particles.vy(), particles.vz() };
+	float* acc[3] = { particles.ax(), particles.ay(), particles.az() };
+	const float* mass = particles.mass();
+
+	for (size_t i = begin; (i < end) && (i < num); i++)
+	{
+		double sum_acc[3] = { 0.0, 0.0, 0.0 };
+		double sum_jerk[3] = { 0.0, 0.0, 0.0 };
+
+		for (size_t j = 0; j < num; j++)
+		{
+			const float d[3] = { pos[0][j] - pos[0][i], pos[1][j] - pos[1][i], pos[2][j] - pos[2][i] };
+			const float dv[3] = { vel[0][j] - vel[0][i], vel[1][j] - vel[1][i], vel[2][j] - vel[2][i] };
+			const float r = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+			if (r > settings.radius)
+			{
+				const float inv_r2 = 1.0f / (r * r);
+				const float coef = mass[j] * inv_r2 / r;
+				const float rv = 3.0f * (d[0] * dv[0] + d[1] * dv[1] + d[2] * dv[2]) * inv_r2;
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					sum_acc[k] += coef * d[k];
+					sum_jerk[k] += coef * (dv[k] - rv * d[k]);
+				}
+			}
+			else
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					sum_acc[k] -= settings.repulsion * d[k];
+					sum_jerk[k] -= settings.repulsion * dv[k];
+				}
+			}
+		}
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			acc[k][i] = static_cast<float>(sum_acc[k]);
+			jerk[k][i] = static_cast<float>(sum_jerk[k]);
+		}
+	}
+}
+
+
+void Direct_sum::accelerations(Particles& particles, const Settings& settings) const
+{
+	const Isa isa = (settings.accumulation == Settings::Accumulation::FLOAT) ? m_isa : Isa::SCALAR;
+	const bool compensated = (settings.accumulation != Settings::Accumulation::FLOAT);
+
+	// blocks cover the padded capacity, so every SIMD load is aligned and full width
+	Utils::parallel_for(particles.capacity(), m_block, [&](size_t begin, size_t end)
+	{
+		switch (isa)
+		{
+		case Isa::AVX512:
+			soa_avx512(particles, begin, end, settings);
+			break;
+
+		case Isa::AVX2:
+			soa_avx2(particles, begin, end, settings);
+			break;
+
+		default:
+			if (compensated)
+				soa_compensated(particles, begin, end, settings);
+			else
+				soa_scalar(particles, begin, end, settings);
+			break;
+		}
+	});
+}
+
+
+void Direct_sum::accelerations(Particles& particles, const Settings& settings, float* const* jerk) const
+{
+	// the Hermite integrator also needs the time derivative of every acceleration
+	Utils::parallel_for(particles.size(), m_block, [&](size_t begin, size_t end)
+	{
+		soa_jerk(particles, begin, end, settings, jerk);
+	});
+}
@@ -0,0 +1,58 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef DIRECT_SUM_H
+#define DIRECT_SUM_H
+
+#include "particles.h"
+#include "settings.h"
+#include "vector4d.h"
+#include <cstddef>
+
+class Direct_sum
+{
+public:
+	enum class Isa
+	{
+		SCALAR,
+		AVX2,
+		AVX512
+	};
+
+private:
+	static const size_t m_block = 64;
+
+	Isa m_isa;
+
+	static void block_scalar(const Vector4D* pos, size_t num, size_t begin, size_t end, const Settings& settings, Vector4D* acc);
+	static void block_avx2(const Vector4D* pos, size_t num, size_t begin, size_t end, const Settings& settings, Vector4D* acc);
+	static void block_avx512(const Vector4D* pos, size_t num, size_t begin, size_t end, const Settings& settings, Vector4D* acc);
+	static void soa_scalar(Particles& particles, size_t begin, size_t end, const Settings& settings);
+	static void soa_avx2(Particles& particles, size_t begin, size_t end, const Settings& settings);
+	static void soa_avx512(Particles& particles, size_t begin, size_t end, const Settings& settings);
+	static void soa_compensated(Particles& particles, size_t begin, size_t end, const Settings& settings);
+	static void soa_jerk(Particles& particles, size_t begin, size_t end, const Settings& settings, float* const* jerk);
+
+public:
+	Direct_sum();
+	static Isa best_isa();
+	static const char* isa_name(Isa isa);
+	void set_isa(Isa isa);
+	Isa get_isa() const;
+	void accelerations(const Vector4D* pos, size_t num, const Settings& settings, Vector4D* acc) const;
+	void accelerations(Particles& particles, const Settings& settings) const;
+	void accelerations(Particles& particles, const Settings& settings, float* const* jerk) const;
+};
+
+#endif
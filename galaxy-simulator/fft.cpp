@@ -0,0 +1,131 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "fft.h"
+#include "utils.h"
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+Fft::Fft() :
+	m_size(0)
+{
+}
+
+
+void Fft::prepare(size_t size)
+{
+	if (size == m_size) return;
+	if ((size < 2) || ((size & (size - 1)) != 0)) throw std::runtime_error("FFT size is not a power of two.");
+
+	m_size = size;
+	m_twiddle.resize(size / 2);
+	m_reverse.resize(size);
+
+	for (size_t k = 0; k < size / 2; k++)
+	{
+		const double angle = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(size);
+		m_twiddle[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+	}
+
+	unsigned bits = 0;
+	while ((static_cast<size_t>(1) << bits) < size) bits++;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		size_t reversed = 0;
+
+		for (unsigned b = 0; b < bits; b++)
+		{
+			if (i & (static_cast<size_t>(1) << b)) reversed |= static_cast<size_t>(1) << (bits - 1 - b);
+		}
+
+		m_reverse[i] = reversed;
+	}
+}
+
+
+void Fft::transform_line(std::complex<float>* line, bool inverse) const
+{
+	for (size_t i = 0; i < m_size; i++)
+	{
+		if (i < m_reverse[i]) std::swap(line[i], line[m_reverse[i]]);
+	}
+
+	for (size_t len = 2; len <= m_size; len <<= 1)
+	{
+		const size_t half = len / 2;
+		const size_t step = m_size / len;
+
+		for (size_t i = 0; i < m_size; i += len)
+		{
+			for (size_t k = 0; k < half; k++)
+			{
+				const std::complex<float> w = inverse ? std::conj(m_twiddle[k * step]) : m_twiddle[k * step];
+				const std::complex<float> u = line[i + k];
+				const std::complex<float> v = line[i + k + half] * w;
+
+				line[i + k] = u + v;
+				line[i + k + half] = u - v;
+			}
+		}
+	}
+}
+
+
+void Fft::transform(std::complex<float>* data, size_t size, bool inverse)
+{
+	prepare(size);
+
+	const size_t strides[3] = { 1, size, size * size };
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const size_t stride = strides[axis];
+
+		Utils::parallel_for(size * size, 16, [&](size_t begin, size_t end)
+		{
+			std::vector<std::complex<float>> line(size);
+
+			for (size_t l = begin; l < end; l++)
+			{
+				const size_t a = l % size;
+				const size_t b = l / size;
+				size_t offset;
+
+				if (axis == 0) offset = (b * size + a) * size;
+				else if (axis == 1) offset = b * size * size + a;
+				else offset = b * size + a;
+
+				for (size_t i = 0; i < size; i++)
+				{
+					line[i] = data[offset + i * stride];
+				}
+
+				transform_line(line.data(), inverse);
+
+				for (size_t i = 0; i < size; i++)
+				{
+					data[offset + i * stride] = line[i];
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,37 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+class Fft
+{
+private:
+	size_t m_size;
+	std::vector<std::complex<float>> m_twiddle;
+	std::vector<size_t> m_reverse;
+
+	void prepare(size_t size);
+	void transform_line(std::complex<float>* line, bool inverse) const;
+
+public:
+	Fft();
+	void transform(std::complex<float>* data, size_t size, bool inverse);
+};
+
+#endif
@@ -0,0 +1,579 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "fmm.h"
+#include "gravity.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+
+static std::uint64_t spread_bits(std::uint64_t v)
+{
+	v &= 0x1fffff;
+	v = (v | (v << 32)) & 0x1f00000000ffffULL;
+	v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+	v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+	v = (v | (v << 2)) & 0x1249249249249249ULL;
+	return v;
+}
+
+
+static std::uint64_t compact_bits(std::uint64_t v)
+{
+	v &= 0x1249249249249249ULL;
+	v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ULL;
+	v = (v ^ (v >> 4)) & 0x100f00f00f00f00fULL;
+	v = (v ^ (v >> 8)) & 0x1f0000ff0000ffULL;
+	v = (v ^ (v >> 16)) & 0x1f00000000ffffULL;
+	v = (v ^ (v >> 32)) & 0x1fffff;
+	return v;
+}
+
+
+static std::uint64_t encode(std::uint64_t x, std::uint64_t y, std::uint64_t z)
+{
+	return spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2);
+}
+
+
+static void decode(std::uint64_t key, std::int64_t& x, std::int64_t& y, std::int64_t& z)
+{
+	x = static_cast<std::int64_t>(compact_bits(key));
+	y = static_cast<std::int64_t>(compact_bits(key >> 1));
+	z = static_cast<std::int64_t>(compact_bits(key >> 2));
+}
+
+
+Fmm::Fmm() :
+	m_order(0),
+	m_num_coefs(0),
+	m_size(1.0f)
+{
+	m_origin[0] = 0.0f;
+	m_origin[1] = 0.0f;
+	m_origin[2] = 0.0f;
+}
+
+
+void Fmm::set_order(unsigned order)
+{
+	if ((order == m_order) && !m_power.empty()) return;
+
+	m_order = order;
+	m_power.clear();
+
+	for (int n = 0; n <= static_cast<int>(order); n++)
+	{
+		for (int a = n; a >= 0; a--)
+		{
+			for (int b = n - a; b >= 0; b--)
+			{
+				m_power.push_back(a);
+				m_power.push_back(b);
+				m_power.push_back(n - a - b);
+			}
+		}
+	}
+
+	m_num_coefs = m_power.size() / 3;
+
+	m_lookup.assign((order + 1) * (order + 1) * (order + 1), -1);
+	for (size_t i = 0; i < m_num_coefs; i++)
+	{
+		m_lookup[(m_power[3 * i] * (order + 1) + m_power[3 * i + 1]) * (order + 1) + m_power[3 * i + 2]] = static_cast<int>(i);
+	}
+
+	m_shifts.clear();
+	m_m2l.clear();
+
+	for (size_t k = 0; k < m_num_coefs; k++)
+	{
+		const int* pk = &m_power[3 * k];
+
+		for (size_t q = 0; q < m_num_coefs; q++)
+		{
+			const int* pq = &m_power[3 * q];
+
+			if ((pq[0] <= pk[0]) && (pq[1] <= pk[1]) && (pq[2] <= pk[2]))
+				m_shifts.push_back({ static_cast<int>(k), static_cast<int>(q), lookup(pk[0] - pq[0], pk[1] - pq[1], pk[2] - pq[2]) });
+
+			if (pk[0] + pk[1] + pk[2] + pq[0] + pq[1] + pq[2] <= static_cast<int>(order))
+				m_m2l.push_back({ static_cast<int>(k), static_cast<int>(q), lookup(pk[0] + pq[0], pk[1] + pq[1], pk[2] + pq[2]) });
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		m_gradient[axis].clear();
+
+		for (size_t n = 0; n < m_num_coefs; n++)
+		{
+			int p[3] = { m_power[3 * n], m_power[3 * n + 1], m_power[3 * n + 2] };
+			if (p[axis] == 0) continue;
+
+			p[axis]--;
+			m_gradient[axis].push_back({ static_cast<int>(n), lookup(p[0], p[1], p[2]), 0 });
+		}
+	}
+}
+
+
+int Fmm::lookup(int a, int b, int c) const
+{
+	return m_lookup[(a * (m_order + 1) + b) * (m_order + 1) + c];
+}
+
+
+void Fmm::monomials(double x, double y, double z, double* mono) const
+{
+	double px[32], py[32], pz[32];
+	px[0] = py[0] = pz[0] = 1.0;
+
+	for (unsigned n = 1; n <= m_order; n++)
+	{
+		px[n] = px[n - 1] * x / n;
+		py[n] = py[n - 1] * y / n;
+		pz[n] = pz[n - 1] * z / n;
+	}
+
+	for (size_t i = 0; i < m_num_coefs; i++)
+	{
+		mono[i] = px[m_power[3 * i]] * py[m_power[3 * i + 1]] * pz[m_power[3 * i + 2]];
+	}
+}
+
+
+void Fmm::derivatives(double x, double y, double z, double* deriv) const
+{
+	const size_t stride = m_num_coefs;
+	std::vector<double> table((m_order + 1) * stride, 0.0);
+
+	const double r2 = x * x + y * y + z * z;
+	double value = 1.0 / std::sqrt(r2);
+
+	for (unsigned j = 0; j <= m_order; j++)
+	{
+		table[j * stride] = value;
+		value *= -(2.0 * j + 1.0) / r2;
+	}
+
+	for (size_t i = 1; i < m_num_coefs; i++)
+	{
+		const int t = m_power[3 * i];
+		const int u = m_power[3 * i + 1];
+		const int v = m_power[3 * i + 2];
+		const unsigned n = t + u + v;
+
+		for (unsigned j = 0; j + n <= m_order; j++)
+		{
+			const double* next = &table[(j + 1) * stride];
+			double result;
+
+			if (t > 0)
+			{
+				result = x * next[lookup(t - 1, u, v)];
+				if (t > 1) result += (t - 1) * next[lookup(t - 2, u, v)];
+			}
+			else if (u > 0)
+			{
+				result = y * next[lookup(t, u - 1, v)];
+				if (u > 1) result += (u - 1) * next[lookup(t, u - 2, v)];
+			}
+			else
+			{
+				result = z * next[lookup(t, u, v - 1)];
+				if (v > 1) result += (v - 1) * next[lookup(t, u, v - 2)];
+			}
+
+			table[j * stride + i] = result;
+		}
+	}
+
+	std::copy(table.begin(), table.begin() + stride, deriv);
+}
+
+
+void Fmm::offset_derivatives(unsigned level)
+{
+	const double h = cell_size(level);
+	m_offset_derivatives.assign(7 * 7 * 7 * m_num_coefs, 0.0);
+
+	for (int dx = -3; dx <= 3; dx++)
+	{
+		for (int dy = -3; dy <= 3; dy++)
+		{
+			for (int dz = -3; dz <= 3; dz++)
+			{
+				if ((std::abs(dx) <= 1) && (std::abs(dy) <= 1) && (std::abs(dz) <= 1)) continue;
+
+				derivatives(dx * h, dy * h, dz * h,
+					&m_offset_derivatives[(((dx + 3) * 7 + (dy + 3)) * 7 + (dz + 3)) * m_num_coefs]);
+			}
+		}
+	}
+}
+
+
+double Fmm::cell_size(unsigned level) const
+{
+	return static_cast<double>(m_size) / static_cast<double>(1ULL << level);
+}
+
+
+void Fmm::cell_centre(unsigned level, std::uint64_t key, double* centre) const
+{
+	std::int64_t x, y, z;
+	decode(key, x, y, z);
+
+	const double h = cell_size(level);
+	centre[0] = m_origin[0] + (x + 0.5) * h;
+	centre[1] = m_origin[1] + (y + 0.5) * h;
+	centre[2] = m_origin[2] + (z + 0.5) * h;
+}
+
+
+std::int64_t Fmm::find_cell(unsigned level, std::int64_t x, std::int64_t y, std::int64_t z) const
+{
+	const std::int64_t limit = static_cast<std::int64_t>(1) << level;
+	if ((x < 0) || (y < 0) || (z < 0) || (x >= limit) || (y >= limit) || (z >= limit)) return -1;
+
+	const auto& keys = m_levels[level].keys;
+	const std::uint64_t key = encode(x, y, z);
+	const auto it = std::lower_bound(keys.begin(), keys.end(), key);
+
+	if ((it == keys.end()) || (*it != key)) return -1;
+	return it - keys.begin();
+}
+
+
+void Fmm::direct(const Bodies& bodies, size_t num, const Settings& settings) const
+{
+	Utils::parallel_for(num, 64, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vector4D pos_i = bodies.position(i);
+			Vector4D acc_i = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+			for (size_t j = 0; j < num; j++)
+			{
+				Gravity::interaction(pos_i, bodies.position(j), settings, acc_i);
+			}
+
+			bodies.set_acceleration(i, acc_i);
+		}
+	});
+}
+
+
+void Fmm::accelerations(const Bodies& bodies, size_t num, const Settings& settings)
+{
+	if (num == 0) return;
+
+	set_order(static_cast<unsigned>(Utils::clamp(static_cast<float>(settings.fmm_order), 1.0f, 16.0f)));
+
+	const Vector4D first = bodies.position(0);
+	float min_pos[3] = { first.x, first.y, first.z };
+	float max_pos[3] = { first.x, first.y, first.z };
+
+	for (size_t i = 0; i < num; i++)
+	{
+		const Vector4D pos = bodies.position(i);
+		min_pos[0] = std::min(min_pos[0], pos.x);
+		min_pos[1] = std::min(min_pos[1], pos.y);
+		min_pos[2] = std::min(min_pos[2], pos.z);
+		max_pos[0] = std::max(max_pos[0], pos.x);
+		max_pos[1] = std::max(max_pos[1], pos.y);
+		max_pos[2] = std::max(max_pos[2], pos.z);
+	}
+
+	m_size = std::max(max_pos[0] - min_pos[0], std::max(max_pos[1] - min_pos[1], max_pos[2] - min_pos[2]));
+	m_size = (m_size > 0.0f) ? (m_size * 1.001f) : 1.0f;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		m_origin[axis] = 0.5f * (min_pos[axis] + max_pos[axis]) - 0.5f * m_size;
+	}
+
+	unsigned max_level = 0;
+	while ((max_level < m_max_level) && (cell_size(max_level + 1) >= settings.radius)) max_level++;
+
+	if (max_level < 2)
+	{
+		direct(bodies, num, settings);
+		return;
+	}
+
+	std::vector<std::pair<std::uint64_t, std::int32_t>> sorted(num);
+	const double scale = static_cast<double>(1ULL << max_level) / m_size;
+	const std::int64_t limit = (static_cast<std::int64_t>(1) << max_level) - 1;
+
+	for (size_t i = 0; i < num; i++)
+	{
+		const Vector4D pos = bodies.position(i);
+		const std::int64_t x = std::min(std::max(static_cast<std::int64_t>((pos.x - m_origin[0]) * scale), std::int64_t(0)), limit);
+		const std::int64_t y = std::min(std::max(static_cast<std::int64_t>((pos.y - m_origin[1]) * scale), std::int64_t(0)), limit);
+		const std::int64_t z = std::min(std::max(static_cast<std::int64_t>((pos.z - m_origin[2]) * scale), std::int64_t(0)), limit);
+		sorted[i] = std::make_pair(encode(x, y, z), static_cast<std::int32_t>(i));
+	}
+
+	std::sort(sorted.begin(), sorted.end());
+
+	unsigned leaf_level = 2;
+	for (; leaf_level < max_level; leaf_level++)
+	{
+		const unsigned shift = 3 * (max_level - leaf_level);
+		size_t max_occupancy = 0;
+		size_t first = 0;
+
+		// the densest cell bounds the near-field cost, so no occupied cell may exceed the leaf size
+		for (size_t i = 1; i <= num; i++)
+		{
+			if ((i == num) || ((sorted[i].first >> shift) != (sorted[i - 1].first >> shift)))
+			{
+				max_occupancy = std::max(max_occupancy, i - first);
+				first = i;
+			}
+		}
+
+		if (max_occupancy <= m_leaf_size) break;
+	}
+
+	m_levels.assign(leaf_level + 1, Level());
+	m_body.resize(num);
+	m_body_key.resize(num);
+	m_leaf_first.clear();
+
+	for (size_t i = 0; i < num; i++)
+	{
+		m_body[i] = sorted[i].second;
+		m_body_key[i] = sorted[i].first >> (3 * (max_level - leaf_level));
+
+		if ((i == 0) || (m_body_key[i] != m_body_key[i - 1]))
+		{
+			m_levels[leaf_level].keys.push_back(m_body_key[i]);
+			m_leaf_first.push_back(i);
+		}
+	}
+
+	m_leaf_first.push_back(num);
+
+	for (unsigned level = leaf_level; level > 0; level--)
+	{
+		const auto& child_keys = m_levels[level].keys;
+		auto& keys = m_levels[level - 1].keys;
+
+		for (size_t c = 0; c < child_keys.size(); c++)
+		{
+			if ((c == 0) || ((child_keys[c] >> 3) != (child_keys[c - 1] >> 3))) keys.push_back(child_keys[c] >> 3);
+		}
+	}
+
+	for (auto& level : m_levels)
+	{
+		level.multipole.assign(level.keys.size() * m_num_coefs, 0.0);
+		level.local.assign(level.keys.size() * m_num_coefs, 0.0);
+	}
+
+	const double mass = settings.mass;
+	Level& leaves = m_levels[leaf_level];
+
+	Utils::parallel_for(leaves.keys.size(), 16, [&](size_t begin, size_t end)
+	{
+		std::vector<double> mono(m_num_coefs);
+		double centre[3];
+
+		for (size_t c = begin; c < end; c++)
+		{
+			cell_centre(leaf_level, leaves.keys[c], centre);
+			double* multipole = &leaves.multipole[c * m_num_coefs];
+
+			for (size_t b = m_leaf_first[c]; b < m_leaf_first[c + 1]; b++)
+			{
+				const Vector4D p = bodies.position(m_body[b]);
+				monomials(centre[0] - p.x, centre[1] - p.y, centre[2] - p.z, mono.data());
+
+				for (size_t k = 0; k < m_num_coefs; k++)
+				{
+					multipole[k] += mass * mono[k];
+				}
+			}
+		}
+	});
+
+	for (unsigned level = leaf_level - 1; level >= 2; level--)
+	{
+		Level& parents = m_levels[level];
+		const Level& children = m_levels[level + 1];
+
+		Utils::parallel_for(parents.keys.size(), 16, [&](size_t begin, size_t end)
+		{
+			std::vector<double> mono(m_num_coefs);
+			double parent_centre[3], child_centre[3];
+
+			for (size_t c = begin; c < end; c++)
+			{
+				cell_centre(level, parents.keys[c], parent_centre);
+				double* multipole = &parents.multipole[c * m_num_coefs];
+
+				auto child = std::lower_bound(children.keys.begin(), children.keys.end(), parents.keys[c] << 3);
+
+				for (; (child != children.keys.end()) && ((*child >> 3) == parents.keys[c]); ++child)
+				{
+					cell_centre(level + 1, *child, child_centre);
+					monomials(parent_centre[0] - child_centre[0], parent_centre[1] - child_centre[1],
+						parent_centre[2] - child_centre[2], mono.data());
+
+					const double* child_multipole = &children.multipole[(child - children.keys.begin()) * m_num_coefs];
+
+					for (const Shift& shift : m_shifts)
+					{
+						multipole[shift.big] += child_multipole[shift.small] * mono[shift.diff];
+					}
+				}
+			}
+		});
+	}
+
+	for (unsigned level = 2; level <= leaf_level; level++)
+	{
+		Level& cells = m_levels[level];
+		offset_derivatives(level);
+
+		Utils::parallel_for(cells.keys.size(), 16, [&](size_t begin, size_t end)
+		{
+			for (size_t c = begin; c < end; c++)
+			{
+				std::int64_t x, y, z;
+				decode(cells.keys[c], x, y, z);
+				double* local = &cells.local[c * m_num_coefs];
+
+				for (std::int64_t sx = 2 * ((x >> 1) - 1); sx <= 2 * ((x >> 1) + 1) + 1; sx++)
+				{
+					for (std::int64_t sy = 2 * ((y >> 1) - 1); sy <= 2 * ((y >> 1) + 1) + 1; sy++)
+					{
+						for (std::int64_t sz = 2 * ((z >> 1) - 1); sz <= 2 * ((z >> 1) + 1) + 1; sz++)
+						{
+							if ((std::abs(sx - x) <= 1) && (std::abs(sy - y) <= 1) && (std::abs(sz - z) <= 1)) continue;
+
+							const std::int64_t source = find_cell(level, sx, sy, sz);
+							if (source < 0) continue;
+
+							const double* multipole = &cells.multipole[source * m_num_coefs];
+							const double* deriv = &m_offset_derivatives[(((x - sx + 3) * 7 + (y - sy + 3)) * 7 + (z - sz + 3)) * m_num_coefs];
+
+							for (const Shift& shift : m_m2l)
+							{
+								local[shift.big] -= multipole[shift.small] * deriv[shift.diff];
+							}
+						}
+					}
+				}
+			}
+		});
+	}
+
+	for (unsigned level = 2; level < leaf_level; level++)
+	{
+		const Level& parents = m_levels[level];
+		Level& children = m_levels[level + 1];
+
+		Utils::parallel_for(children.keys.size(), 16, [&](size_t begin, size_t end)
+		{
+			std::vector<double> mono(m_num_coefs);
+			double parent_centre[3], child_centre[3];
+
+			for (size_t c = begin; c < end; c++)
+			{
+				const std::uint64_t parent_key = children.keys[c] >> 3;
+				const size_t parent = std::lower_bound(parents.keys.begin(), parents.keys.end(), parent_key) - parents.keys.begin();
+
+				cell_centre(level, parent_key, parent_centre);
+				cell_centre(level + 1, children.keys[c], child_centre);
+				monomials(child_centre[0] - parent_centre[0], child_centre[1] - parent_centre[1],
+					child_centre[2] - parent_centre[2], mono.data());
+
+				const double* parent_local = &parents.local[parent * m_num_coefs];
+				double* local = &children.local[c * m_num_coefs];
+
+				for (const Shift& shift : m_shifts)
+				{
+					local[shift.small] += parent_local[shift.big] * mono[shift.diff];
+				}
+			}
+		});
+	}
+
+	Utils::parallel_for(leaves.keys.size(), 16, [&](size_t begin, size_t end)
+	{
+		std::vector<double> mono(m_num_coefs);
+		double centre[3];
+
+		for (size_t c = begin; c < end; c++)
+		{
+			std::int64_t x, y, z;
+			decode(leaves.keys[c], x, y, z);
+			cell_centre(leaf_level, leaves.keys[c], centre);
+			const double* local = &leaves.local[c * m_num_coefs];
+
+			std::int64_t neighbours[27];
+			int num_neighbours = 0;
+
+			for (std::int64_t nx = x - 1; nx <= x + 1; nx++)
+			{
+				for (std::int64_t ny = y - 1; ny <= y + 1; ny++)
+				{
+					for (std::int64_t nz = z - 1; nz <= z + 1; nz++)
+					{
+						const std::int64_t neighbour = find_cell(leaf_level, nx, ny, nz);
+						if (neighbour >= 0) neighbours[num_neighbours++] = neighbour;
+					}
+				}
+			}
+
+			for (size_t b = m_leaf_first[c]; b < m_leaf_first[c + 1]; b++)
+			{
+				const std::int32_t i = m_body[b];
+				const Vector4D pos_i = bodies.position(i);
+				monomials(pos_i.x - centre[0], pos_i.y - centre[1], pos_i.z - centre[2], mono.data());
+
+				double far[3] = { 0.0, 0.0, 0.0 };
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					for (const Shift& shift : m_gradient[axis])
+					{
+						far[axis] -= local[shift.big] * mono[shift.small];
+					}
+				}
+
+				Vector4D acc_i = { static_cast<float>(far[0]), static_cast<float>(far[1]), static_cast<float>(far[2]), 0.0f };
+
+				for (int n = 0; n < num_neighbours; n++)
+				{
+					for (size_t j = m_leaf_first[neighbours[n]]; j < m_leaf_first[neighbours[n] + 1]; j++)
+					{
+						Gravity::interaction(pos_i, bodies.position(m_body[j]), settings, acc_i);
+					}
+				}
+
+				bodies.set_acceleration(i, acc_i);
+			}
+		}
+	});
+}
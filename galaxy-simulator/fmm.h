@@ -0,0 +1,75 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FMM_H
+#define FMM_H
+
+#include "bodies.h"
+#include "settings.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Fmm
+{
+private:
+	struct Level
+	{
+		std::vector<std::uint64_t> keys;
+		std::vector<double> multipole;
+		std::vector<double> local;
+	};
+
+	struct Shift
+	{
+		int big;
+		int small;
+		int diff;
+	};
+
+	static const size_t m_leaf_size = 64;
+	static const unsigned m_max_level = 10;
+
+	unsigned m_order;
+	size_t m_num_coefs;
+	std::vector<int> m_power;
+	std::vector<int> m_lookup;
+	std::vector<Shift> m_shifts;
+	std::vector<Shift> m_m2l;
+	std::vector<Shift> m_gradient[3];
+	std::vector<double> m_offset_derivatives;
+
+	float m_origin[3];
+	float m_size;
+	std::vector<Level> m_levels;
+	std::vector<std::uint64_t> m_body_key;
+	std::vector<std::int32_t> m_body;
+	std::vector<size_t> m_leaf_first;
+
+	void set_order(unsigned order);
+	int lookup(int a, int b, int c) const;
+	void monomials(double x, double y, double z, double* mono) const;
+	void derivatives(double x, double y, double z, double* deriv) const;
+	void offset_derivatives(unsigned level);
+	double cell_size(unsigned level) const;
+	void cell_centre(unsigned level, std::uint64_t key, double* centre) const;
+	std::int64_t find_cell(unsigned level, std::int64_t x, std::int64_t y, std::int64_t z) const;
+	void direct(const Bodies& bodies, size_t num, const Settings& settings) const;
+
+public:
+	Fmm();
+	void accelerations(const Bodies& bodies, size_t num, const Settings& settings);
+};
+
+#endif
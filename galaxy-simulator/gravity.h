@@ -0,0 +1,69 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+#include "settings.h"
+#include "vector4d.h"
+#include <cmath>
+
+class Gravity
+{
+private:
+	Gravity() = delete;
+	~Gravity() = delete;
+
+public:
+	static inline void interaction(const Vector4D& pos_i, const Vector4D& pos_j, const Settings& settings, Vector4D& acc)
+	{
+		const float dx = pos_j.x - pos_i.x;
+		const float dy = pos_j.y - pos_i.y;
+		const float dz = pos_j.z - pos_i.z;
+		const float r = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+		const float coef = (r > settings.radius) ? (settings.mass / r / r / r) : -settings.repulsion;
+
+		acc.x += coef * dx;
+		acc.y += coef * dy;
+		acc.z += coef * dz;
+	}
+
+	static inline float short_range_factor(const float r, const float split)
+	{
+		const float u = r / (2.0f * split);
+		return std::erfc(u) + 1.12837917f * u * std::exp(-u * u);
+	}
+
+	static inline void short_range_interaction(const Vector4D& pos_i, const Vector4D& pos_j, const Settings& settings,
+		const float split, Vector4D& acc)
+	{
+		const float dx = pos_j.x - pos_i.x;
+		const float dy = pos_j.y - pos_i.y;
+		const float dz = pos_j.z - pos_i.z;
+		const float r = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+		if (r <= 0.0f) return;
+
+		const float newton = settings.mass / r / r / r;
+		const float factor = short_range_factor(r, split);
+		const float coef = (r > settings.radius) ? (newton * factor) : (-settings.repulsion - newton * (1.0f - factor));
+
+		acc.x += coef * dx;
+		acc.y += coef * dy;
+		acc.z += coef * dz;
+	}
+};
+
+#endif
@@ -0,0 +1,345 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "host_backend.h"
+#include "utils.h"
+#include <cmath>
+
+
+Host_backend::Host_backend(GLsizei num, bool tree, Precision precision, Packing packing) :
+	m_num(num),
+	m_tree(tree),
+	m_precision(precision),
+	m_packing(packing),
+	m_acc_valid(false),
+	m_jerk_valid(false),
+	m_mass(0.0f),
+	m_particles(num),
+	m_pos(std::make_unique<Vector4D[]>(num)),
+	m_packed((packing != Packing::FLOAT) ? std::make_unique<unsigned char[]>(num * packed_size(packing)) : nullptr)
+{
+}
+
+
+bool Host_backend::init(const Settings& settings, const GLuint* vbos, size_t num_vbos, const Vector4D* pos, const Vector4D* vel)
+{
+	m_force_settings = settings;
+	m_vbos.assign(vbos, vbos + num_vbos);
+	m_particles.load(pos, vel);
+	m_acc_valid = false;
+	m_jerk_valid = false;
+	return true;
+}
+
+
+void Host_backend::set_mass(float mass)
+{
+	if (m_mass != mass)
+	{
+		m_particles.fill_mass(mass);
+		m_mass = mass;
+	}
+}
+
+
+void Host_backend::accelerate(const Settings& settings)
+{
+	// the device-only solvers run on the host as this backend's own flavour of force loop
+	Settings host_settings = settings;
+
+	if ((settings.solver == Settings::Solver::DIRECT) || (settings.solver == Settings::Solver::BARNES_HUT))
+		host_settings.solver = m_tree ? Settings::Solver::BARNES_HUT_HOST : Settings::Solver::DIRECT;
+
+	// the particles stay float on the host, so the wider precisions widen the force sum instead
+	if (m_precision != Precision::FLOAT)
+		host_settings.accumulation = Settings::Accumulation::DOUBLE;
+
+	set_mass(settings.mass);
+	m_solvers.accelerations(m_particles, host_settings);
+}
+
+
+void Host_backend::accelerate_jerk(const Settings& settings)
+{
+	for (auto& component : m_jerk)
+	{
+		component.resize(m_num);
+	}
+
+	float* jerk[3] = { m_jerk[0].data(), m_jerk[1].data(), m_jerk[2].data() };
+
+	set_mass(settings.mass);
+	m_solvers.direct_sum().accelerations(m_particles, settings, jerk);
+}
+
+
+void Host_backend::drift(float time_step)
+{
+	float* x = m_particles.x();
+	float* y = m_particles.y();
+	float* z = m_particles.z();
+	float* vx = m_particles.vx();
+	float* vy = m_particles.vy();
+	float* vz = m_particles.vz();
+
+	Utils::parallel_for(m_num, 1024, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			x[i] += time_step * vx[i];
+			y[i] += time_step * vy[i];
+			z[i] += time_step * vz[i];
+
+			const float r = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+
+			if (r > 1.0f)
+			{
+				const float nx = x[i] / r, ny = y[i] / r, nz = z[i] / r;
+				const float v_n = nx * vx[i] + ny * vy[i] + nz * vz[i];
+
+				x[i] = 2.0f * nx - x[i];
+				y[i] = 2.0f * ny - y[i];
+				z[i] = 2.0f * nz - z[i];
+
+				vx[i] -= v_n * nx;
+				vy[i] -= v_n * ny;
+				vz[i] -= v_n * nz;
+			}
+		}
+	});
+}
+
+
+void Host_backend::kick(float time_step)
+{
+	float* vx = m_particles.vx();
+	float* vy = m_particles.vy();
+	float* vz = m_particles.vz();
+	const float* ax = m_particles.ax();
+	const float* ay = m_particles.ay();
+	const float* az = m_particles.az();
+
+	Utils::parallel_for(m_num, 1024, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			vx[i] += time_step * ax[i];
+			vy[i] += time_step * ay[i];
+			vz[i] += time_step * az[i];
+
+			const float v = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i]);
+
+			if (v > 1.0f)
+			{
+				vx[i] /= v;
+				vy[i] /= v;
+				vz[i] /= v;
+			}
+		}
+	});
+}
+
+
+void Host_backend::hermite_predict(float time_step)
+{
+	float* pos[3] = { m_particles.x(), m_particles.y(), m_particles.z() };
+	float* vel[3] = { m_particles.vx(), m_particles.vy(), m_particles.vz() };
+	const float* acc[3] = { m_particles.ax(), m_particles.ay(), m_particles.az() };
+
+	for (int k = 0; k < 3; k++)
+	{
+		m_pos_old[k].resize(m_num);
+		m_vel_old[k].resize(m_num);
+		m_acc_old[k].resize(m_num);
+		m_jerk_old[k].resize(m_num);
+	}
+
+	Utils::parallel_for(m_num, 1024, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const float jerk = m_jerk[k][i];
+
+				m_pos_old[k][i] = pos[k][i];
+				m_vel_old[k][i] = vel[k][i];
+				m_acc_old[k][i] = acc[k][i];
+				m_jerk_old[k][i] = jerk;
+
+				pos[k][i] += time_step * (vel[k][i] + time_step * (0.5f * acc[k][i] + time_step * (1.0f / 6.0f) * jerk));
+				vel[k][i] += time_step * (acc[k][i] + time_step * 0.5f * jerk);
+			}
+		}
+	});
+}
+
+
+void Host_backend::hermite_correct(float time_step)
+{
+	float* pos[3] = { m_particles.x(), m_particles.y(), m_particles.z() };
+	float* vel[3] = { m_particles.vx(), m_particles.vy(), m_particles.vz() };
+	const float* acc[3] = { m_particles.ax(), m_particles.ay(), m_particles.az() };
+
+	Utils::parallel_for(m_num, 1024, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			float p[3], v[3];
+
+			for (int k = 0; k < 3; k++)
+			{
+				v[k] = m_vel_old[k][i] + 0.5f * time_step * (m_acc_old[k][i] + acc[k][i]) +
+					(time_step * time_step / 12.0f) * (m_jerk_old[k][i] - m_jerk[k][i]);
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = m_pos_old[k][i] + 0.5f * time_step * (m_vel_old[k][i] + v[k]) +
+					(time_step * time_step / 12.0f) * (m_acc_old[k][i] - acc[k][i]);
+			}
+
+			const float r = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+
+			if (r > 1.0f)
+			{
+				const float n[3] = { p[0] / r, p[1] / r, p[2] / r };
+				const float v_n = n[0] * v[0] + n[1] * v[1] + n[2] * v[2];
+
+				for (int k = 0; k < 3; k++)
+				{
+					p[k] = 2.0f * n[k] - p[k];
+					v[k] -= v_n * n[k];
+				}
+			}
+
+			const float speed = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+			for (int k = 0; k < 3; k++)
+			{
+				pos[k][i] = p[k];
+				vel[k][i] = (speed > 1.0f) ? (v[k] / speed) : v[k];
+			}
+		}
+	});
+}
+
+
+void Host_backend::step(const Settings& settings, unsigned steps)
+{
+	// the jerk comes from the direct sum, so the tree backend and the other solvers step Hermite as leapfrog
+	const bool hermite = (settings.integrator == Settings::Integrator::HERMITE) &&
+		(settings.solver == Settings::Solver::DIRECT) && !m_tree;
+	const bool leapfrog = (settings.integrator != Settings::Integrator::EULER);
+	const float time_step = settings.time_step;
+
+	if (!same_forces(m_force_settings, settings))
+	{
+		m_acc_valid = false;
+		m_jerk_valid = false;
+		m_force_settings = settings;
+	}
+
+	for (unsigned s = 0; s < steps; s++)
+	{
+		if (hermite)
+		{
+			if (!m_jerk_valid) accelerate_jerk(settings);
+
+			hermite_predict(time_step);
+			accelerate_jerk(settings);
+			hermite_correct(time_step);
+
+			m_jerk_valid = true;
+		}
+		else
+		{
+			if (leapfrog)
+			{
+				if (!m_acc_valid) accelerate(settings);
+				kick(0.5f * time_step);
+			}
+
+			drift(time_step);
+			accelerate(settings);
+			kick(leapfrog ? (0.5f * time_step) : time_step);
+
+			m_jerk_valid = false;
+		}
+
+		m_acc_valid = true;
+	}
+}
+
+
+void Host_backend::accelerations(const Settings& settings, Vector4D* acc)
+{
+	accelerate(settings);
+	m_particles.store_accelerations(acc);
+	m_acc_valid = true;
+	m_jerk_valid = false;
+	m_force_settings = settings;
+}
+
+
+void Host_backend::map_positions(size_t slot)
+{
+#ifdef HEADLESS
+	static_cast<void>(slot);
+#else
+	// headless stars have no VBOs to map into
+	if (slot >= m_vbos.size()) return;
+
+	m_particles.store_positions(m_pos.get());
+
+	const void* render = m_pos.get();
+
+	if (m_packing != Packing::FLOAT)
+	{
+		pack(m_packing, m_pos.get(), m_num, m_packed.get());
+		render = m_packed.get();
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbos[slot]);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_num * packed_size(m_packing), render);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
+}
+
+
+void Host_backend::positions(Vector4D* pos)
+{
+	m_particles.store_positions(pos);
+}
+
+
+void Host_backend::state(Vector4D* pos, Vector4D* vel)
+{
+	m_particles.store_positions(pos);
+	m_particles.store_velocities(vel);
+}
+
+
+void Host_backend::release()
+{
+	m_acc_valid = false;
+	m_jerk_valid = false;
+}
+
+
+Backend::Kind Host_backend::kind() const
+{
+	return m_tree ? Kind::HOST_TREE : Kind::HOST_SIMD;
+}
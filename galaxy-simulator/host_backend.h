@@ -0,0 +1,68 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HOST_BACKEND_H
+#define HOST_BACKEND_H
+
+#include "backend.h"
+#include "host_solvers.h"
+#include "particles.h"
+#include <memory>
+#include <vector>
+
+class Host_backend : public Backend
+{
+private:
+	const GLsizei m_num;
+	const bool m_tree;
+	const Precision m_precision;
+	const Packing m_packing;
+
+	bool m_acc_valid;
+	bool m_jerk_valid;
+	Settings m_force_settings;
+	float m_mass;
+	Particles m_particles;
+	std::unique_ptr<Vector4D[]> m_pos;
+	std::unique_ptr<unsigned char[]> m_packed;
+	std::vector<GLuint> m_vbos;
+	Host_solvers m_solvers;
+	std::vector<float> m_jerk[3];
+	std::vector<float> m_pos_old[3];
+	std::vector<float> m_vel_old[3];
+	std::vector<float> m_acc_old[3];
+	std::vector<float> m_jerk_old[3];
+
+	void set_mass(float mass);
+	void accelerate(const Settings& settings);
+	void accelerate_jerk(const Settings& settings);
+	void drift(float time_step);
+	void kick(float time_step);
+	void hermite_predict(float time_step);
+	void hermite_correct(float time_step);
+
+public:
+	Host_backend(GLsizei num, bool tree, Precision precision, Packing packing);
+
+	bool init(const Settings& settings, const GLuint* vbos, size_t num_vbos, const Vector4D* pos, const Vector4D* vel) override;
+	void step(const Settings& settings, unsigned steps) override;
+	void accelerations(const Settings& settings, Vector4D* acc) override;
+	void map_positions(size_t slot) override;
+	void positions(Vector4D* pos) override;
+	void state(Vector4D* pos, Vector4D* vel) override;
+	void release() override;
+	Kind kind() const override;
+};
+
+#endif
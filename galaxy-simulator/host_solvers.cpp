@@ -0,0 +1,82 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "host_solvers.h"
+
+
+void Host_solvers::accelerations(const Bodies& bodies, size_t num, const Settings& settings)
+{
+	// the direct sum has a kernel for each layout, so the public overloads dispatch it themselves
+	switch (settings.solver)
+	{
+	case Settings::Solver::BARNES_HUT:
+	case Settings::Solver::BARNES_HUT_HOST:
+		m_octree.build(bodies, num, settings.mass);
+		m_octree.accelerations(bodies, settings);
+		break;
+
+	case Settings::Solver::FMM:
+		m_fmm.accelerations(bodies, num, settings);
+		break;
+
+	case Settings::Solver::PARTICLE_MESH:
+		m_particle_mesh.accelerations(bodies, num, settings);
+		break;
+
+	case Settings::Solver::TREE_PM:
+		m_tree_pm.accelerations(bodies, num, settings);
+		break;
+
+	default:
+		m_symmetric_sum.accelerations(bodies, num, settings);
+		break;
+	}
+}
+
+
+void Host_solvers::accelerations(const Vector4D* pos, size_t num, const Settings& settings, Vector4D* acc)
+{
+	if (settings.solver == Settings::Solver::DIRECT)
+	{
+		m_direct_sum.accelerations(pos, num, settings, acc);
+		return;
+	}
+
+	accelerations(Bodies(pos, acc), num, settings);
+}
+
+
+void Host_solvers::accelerations(Particles& particles, const Settings& settings)
+{
+	if (settings.solver == Settings::Solver::DIRECT)
+	{
+		m_direct_sum.accelerations(particles, settings);
+		return;
+	}
+
+	accelerations(Bodies(particles), particles.size(), settings);
+}
+
+
+Octree& Host_solvers::octree()
+{
+	return m_octree;
+}
+
+
+Direct_sum& Host_solvers::direct_sum()
+{
+	return m_direct_sum;
+}
@@ -0,0 +1,49 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HOST_SOLVERS_H
+#define HOST_SOLVERS_H
+
+#include "bodies.h"
+#include "direct_sum.h"
+#include "fmm.h"
+#include "octree.h"
+#include "particle_mesh.h"
+#include "particles.h"
+#include "settings.h"
+#include "symmetric_sum.h"
+#include "tree_pm.h"
+#include "vector4d.h"
+#include <cstddef>
+
+class Host_solvers
+{
+private:
+	Direct_sum m_direct_sum;
+	Octree m_octree;
+	Fmm m_fmm;
+	Particle_mesh m_particle_mesh;
+	Tree_pm m_tree_pm;
+	Symmetric_sum m_symmetric_sum;
+
+	void accelerations(const Bodies& bodies, size_t num, const Settings& settings);
+
+public:
+	void accelerations(const Vector4D* pos, size_t num, const Settings& settings, Vector4D* acc);
+	void accelerations(Particles& particles, const Settings& settings);
+	Octree& octree();
+	Direct_sum& direct_sum();
+};
+
+#endif
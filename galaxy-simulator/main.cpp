@@ -14,16 +14,28 @@
 
 
 #include <cstdlib>
-#include <GL/glew.h>
-#include <GL/freeglut.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include "benchmark.h"
+#include "opengl.h"
+#include "particle_mesh.h"
+#include "stars.h"
+#include "utils.h"
+#ifndef HEADLESS
 #include "camera.h"
 #include "coordinate_axes.h"
-#include "stars.h"
+#endif
 
 
+Stars stars(1000);
+
+#ifndef HEADLESS
 Camera camera;
 Coordinate_axes coordinate_axes;
-Stars stars(1000);
 
 
 void init(void)
@@ -75,6 +87,7 @@ void reshape(int w, int h)
 void keyboard(unsigned char c, int x, int y)
 {
 	bool changed = false;
+	Settings settings = stars.get_settings();
 
 	switch (c)
 	{
@@ -107,6 +120,95 @@ void keyboard(unsigned char c, int x, int y)
 		camera.set_zoom(camera.get_zoom() * 0.75f); // In
 		changed = true;
 		break;
+
+	case 's':
+		settings.solver = static_cast<Settings::Solver>((static_cast<int>(settings.solver) + 1) % Settings::num_solvers);
+		stars.set_settings(settings);
+		break;
+
+	case 'a':
+		settings.accumulation = static_cast<Settings::Accumulation>((static_cast<int>(settings.accumulation) + 1) % Settings::num_accumulations);
+		stars.set_settings(settings);
+		break;
+
+	case 'd':
+		stars.set_backend(static_cast<Backend::Kind>((static_cast<int>(stars.get_backend()) + 1) % Backend::num_kinds));
+		std::cout << "backend " << Backend::name(stars.get_backend()) << std::endl;
+		break;
+
+	case 'p':
+		stars.set_packing(static_cast<Backend::Packing>((static_cast<int>(stars.get_packing()) + 1) % Backend::num_packings));
+		std::cout << "packing " << Backend::name(stars.get_packing()) << std::endl;
+		break;
+
+	case 'i':
+		settings.integrator = static_cast<Settings::Integrator>((static_cast<int>(settings.integrator) + 1) % Settings::num_integrators);
+		stars.set_settings(settings);
+		break;
+
+	case 't':
+		settings.time_step = Utils::clamp(settings.time_step * 0.5f, 0.00125f, 0.08f);
+		stars.set_settings(settings);
+		break;
+
+	case 'T':
+		settings.time_step = Utils::clamp(settings.time_step * 2.0f, 0.00125f, 0.08f);
+		stars.set_settings(settings);
+		break;
+
+	case 'b':
+		settings.block_levels = (settings.block_levels > 0) ? (settings.block_levels - 1) : 0;
+		stars.set_settings(settings);
+		break;
+
+	case 'B':
+		settings.block_levels = (settings.block_levels < 10) ? (settings.block_levels + 1) : 10;
+		stars.set_settings(settings);
+		break;
+
+	case 'r':
+		std::cout << "reordered " << stars.get_reorder_count() << " times, " << stars.get_reorder_time() << " ms total" << std::endl;
+		break;
+
+	case 'R':
+		settings.reorder_interval = (settings.reorder_interval == 0) ? 16 : ((settings.reorder_interval < 256) ? (settings.reorder_interval * 4) : 0);
+		stars.set_settings(settings);
+		break;
+
+	case 'q':
+		settings.quadrupole = !settings.quadrupole;
+		stars.set_settings(settings);
+		break;
+
+	case '[':
+		settings.opening_angle = Utils::clamp(settings.opening_angle - 0.1f, 0.1f, 1.5f);
+		stars.set_settings(settings);
+		break;
+
+	case ']':
+		settings.opening_angle = Utils::clamp(settings.opening_angle + 0.1f, 0.1f, 1.5f);
+		stars.set_settings(settings);
+		break;
+
+	case 'o':
+		settings.fmm_order = (settings.fmm_order > 1) ? (settings.fmm_order - 1) : 1;
+		stars.set_settings(settings);
+		break;
+
+	case 'O':
+		settings.fmm_order = (settings.fmm_order < 16) ? (settings.fmm_order + 1) : 16;
+		stars.set_settings(settings);
+		break;
+
+	case 'g':
+		settings.pm_grid = (settings.pm_grid > 16) ? (settings.pm_grid / 2) : 16;
+		stars.set_settings(settings);
+		break;
+
+	case 'G':
+		settings.pm_grid = (settings.pm_grid < static_cast<int>(Particle_mesh::max_grid)) ? (settings.pm_grid * 2) : static_cast<int>(Particle_mesh::max_grid);
+		stars.set_settings(settings);
+		break;
 	}
 
 	if (changed)
@@ -115,28 +217,234 @@ void keyboard(unsigned char c, int x, int y)
 
 void timer(int value)
 {
-	stars.calculate();
+	stars.update();
 	glutPostRedisplay();
-	glutTimerFunc(75, timer, 0);
+	glutTimerFunc(16, timer, 0);
 }
+#endif
 
-int main(int argc, char** argv)
+void open_window(int* argc, char** argv)
 {
-	glutInit(&argc, argv);
+#ifdef HEADLESS
+	static_cast<void>(argc);
+	static_cast<void>(argv);
+#else
+	glutInit(argc, argv);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 	glutInitWindowSize(500, 500);
 	glutCreateWindow(argv[0]);
 
 	glewInit();
+#endif
+}
+
+template <typename T>
+bool parse(const std::string& text, T& value)
+{
+	// the whole text has to be the number, and a count may not carry a sign that would wrap around
+	if (text.empty() || (std::is_unsigned<T>::value && (text.find('-') != std::string::npos))) return false;
+
+	std::istringstream stream(text);
+	T parsed;
+	stream >> parsed;
+
+	if (stream.fail() || !stream.eof()) return false;
+
+	value = parsed;
+	return true;
+}
+
+template <typename T>
+bool lookup(const std::string& text, int count, T& value)
+{
+	for (int k = 0; k < count; k++)
+	{
+		if (text == Backend::name(static_cast<T>(k)))
+		{
+			value = static_cast<T>(k);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int usage(const char* program)
+{
+	std::cerr << "usage: " << program << " [--benchmark-simd|--benchmark-fmm|--benchmark-integrators|--benchmark-accumulation|--tune [stars]]" << std::endl;
+	std::cerr << "       " << program << " [--mass m] [--radius r] [--repulsion k] [--rate steps-per-second] [--steps k]" << std::endl;
+	std::cerr << "         [--backend opencl-gpu|opencl-cpu|host-simd|host-tree] [--precision float|mixed|double] [--packing float|half|snorm16]" << std::endl;
+	std::cerr << "       " << program << " --headless stars [--steps k] [--mass m] [--radius r] [--repulsion k] [--backend host-simd|host-tree] [--precision ...]" << std::endl;
+	return EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark-simd"))
+	{
+		unsigned long num = 10000;
+		if ((argc > 3) || ((argc > 2) && !parse(argv[2], num))) return usage(argv[0]);
+
+		Benchmark::simd(num, std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark-fmm"))
+	{
+		unsigned long num = 10000;
+		if ((argc > 3) || ((argc > 2) && !parse(argv[2], num))) return usage(argv[0]);
+
+		open_window(&argc, argv);
+		Benchmark::fmm_orders(num, std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark-integrators"))
+	{
+		unsigned long num = 1000;
+		if ((argc > 3) || ((argc > 2) && !parse(argv[2], num))) return usage(argv[0]);
+
+		open_window(&argc, argv);
+		Benchmark::integrators(num, std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark-accumulation"))
+	{
+		unsigned long num = 50000;
+		if ((argc > 3) || ((argc > 2) && !parse(argv[2], num))) return usage(argv[0]);
+
+		open_window(&argc, argv);
+		Benchmark::accumulation(num, std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	if ((argc > 1) && (std::string(argv[1]) == "--tune"))
+	{
+		unsigned long num = 50000;
+		if ((argc > 3) || ((argc > 2) && !parse(argv[2], num))) return usage(argv[0]);
+
+		open_window(&argc, argv);
+		Stars tuned(num, 1);
+		tuned.init();
+
+		const Backend::Kind devices[] = { Backend::Kind::OPENCL_GPU, Backend::Kind::OPENCL_CPU };
+
+		for (Backend::Kind device : devices)
+		{
+			for (int p = 0; p < Backend::num_precisions; p++)
+			{
+				tuned.set_backend(device);
+				tuned.set_precision(static_cast<Backend::Precision>(p));
+
+				if (tuned.get_backend() == device)
+					tuned.tune(std::cout);
+			}
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+	Settings settings = stars.get_settings();
+	Backend::Kind kind = stars.get_backend();
+	Backend::Precision precision = stars.get_precision();
+	Backend::Packing packing = stars.get_packing();
+	double rate = 0.0;
+	unsigned steps = 1;
+	unsigned long headless = 0;
+
+	for (int a = 1; a < argc; a += 2)
+	{
+		// every option takes a value, so a trailing option without one is as wrong as an unknown option
+		if (a + 1 >= argc) return usage(argv[0]);
+
+		const std::string option = argv[a];
+		const std::string value = argv[a + 1];
+
+		if (option == "--mass")
+		{
+			if (!parse(value, settings.mass) || !(settings.mass > 0.0f)) return usage(argv[0]);
+		}
+		else if (option == "--radius")
+		{
+			if (!parse(value, settings.radius) || !(settings.radius > 0.0f)) return usage(argv[0]);
+		}
+		else if (option == "--repulsion")
+		{
+			if (!parse(value, settings.repulsion) || !(settings.repulsion >= 0.0f)) return usage(argv[0]);
+		}
+		else if (option == "--rate")
+		{
+			if (!parse(value, rate) || !(rate >= 0.0)) return usage(argv[0]);
+		}
+		else if (option == "--steps")
+		{
+			if (!parse(value, steps) || (steps == 0)) return usage(argv[0]);
+		}
+		else if (option == "--headless")
+		{
+			if (!parse(value, headless) || (headless == 0)) return usage(argv[0]);
+		}
+		else if (option == "--backend")
+		{
+			if (!lookup(value, Backend::num_kinds, kind)) return usage(argv[0]);
+		}
+		else if (option == "--precision")
+		{
+			if (!lookup(value, Backend::num_precisions, precision)) return usage(argv[0]);
+		}
+		else if (option == "--packing")
+		{
+			if (!lookup(value, Backend::num_packings, packing)) return usage(argv[0]);
+		}
+		else
+		{
+			return usage(argv[0]);
+		}
+	}
+
+	if (headless > 0)
+	{
+		// one batch on the host without a window, then one star per line on stdout
+		Stars run(headless);
+		run.set_backend(kind);
+		run.set_precision(precision);
+		run.set_packing(packing);
+		run.set_settings(settings);
+		run.init(true);
+		run.calculate(steps);
+
+		auto pos = std::make_unique<Vector4D[]>(run.get_num());
+		run.positions(pos.get());
+
+		std::cout << std::setprecision(9);
+
+		for (GLsizei i = 0; i < run.get_num(); i++)
+			std::cout << pos[i].x << ' ' << pos[i].y << ' ' << pos[i].z << '\n';
+
+		return EXIT_SUCCESS;
+	}
+
+#ifdef HEADLESS
+	return usage(argv[0]);
+#else
+	open_window(&argc, argv);
+
+	stars.set_backend(kind);
+	stars.set_precision(precision);
+	stars.set_packing(packing);
+	stars.set_settings(settings);
 
 	init();
+	stars.start_simulation(rate, steps);
 
 	glutDisplayFunc(display);
 	glutReshapeFunc(reshape);
 	glutKeyboardFunc(keyboard);
-	glutTimerFunc(75, timer, 0);
+	glutTimerFunc(16, timer, 0);
 
 	glutMainLoop();
 
 	return EXIT_SUCCESS;
+#endif
 }
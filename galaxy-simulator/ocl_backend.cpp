@@ -0,0 +1,1863 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "ocl_backend.h"
+#include "stars_ocl.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+static const size_t ocl_max_local_work_size = 256;
+
+
+static std::string ocl_device_string(cl_device_id ocl_device, cl_device_info param)
+{
+	size_t size = 0;
+	if ((clGetDeviceInfo(ocl_device, param, 0, nullptr, &size) != CL_SUCCESS) || (size == 0)) return std::string();
+
+	std::vector<char> value(size);
+	if (clGetDeviceInfo(ocl_device, param, size, value.data(), nullptr) != CL_SUCCESS) return std::string();
+
+	return std::string(value.data());
+}
+
+
+static std::string ocl_binary_file(const std::string& key)
+{
+	char name[64];
+	std::snprintf(name, sizeof(name), "ocl_binary_%016llx.bin", static_cast<unsigned long long>(Utils::hash(key)));
+	return name;
+}
+
+
+Ocl_backend::Ocl_backend(GLsizei num, bool cpu, Precision precision, Packing packing) :
+	m_num(num),
+	m_cpu(cpu),
+	m_precision(precision),
+	m_vector_size((precision == Precision::DOUBLE) ? sizeof(cl_double4) : sizeof(cl_float4)),
+	m_packing(packing),
+	m_interop(false),
+	m_acc_valid(false),
+	m_jerk_valid(false),
+	m_pos_host(std::make_unique<Vector4D[]>(m_num)),
+	m_acc_host(std::make_unique<Vector4D[]>(m_num)),
+	m_key_host(std::make_unique<cl_uint[]>(m_num)),
+	m_order_host(std::make_unique<cl_int[]>(m_num)),
+	m_star_host(std::make_unique<cl_int[]>(m_num)),
+	m_slot_host(std::make_unique<Vector4D[]>(m_num)),
+	m_stage_host((precision == Precision::DOUBLE) ? std::make_unique<cl_double4[]>(m_num) : nullptr),
+	m_render_host((packing != Packing::FLOAT) ? std::make_unique<cl_uchar[]>(m_num * packed_size(packing)) : nullptr),
+	m_steps_since_reorder(0),
+	m_reorder_count(0),
+	m_reorder_time(0.0),
+	m_ocl_context(nullptr),
+	m_ocl_device(nullptr),
+	m_ocl_cmd_queue(nullptr),
+	m_ocl_create_event_from_gl_sync(nullptr),
+	m_gl_sync_rendered(nullptr),
+	m_ocl_event_positions(nullptr),
+	m_ocl_kernel_drift(nullptr),
+	m_ocl_kernel_accelerate(nullptr),
+	m_ocl_kernel_accelerate_kahan(nullptr),
+	m_ocl_kernel_accelerate_double(nullptr),
+	m_ocl_kernel_kick(nullptr),
+	m_ocl_kernel_accelerate_tree(nullptr),
+	m_ocl_kernel_collect_active(nullptr),
+	m_ocl_kernel_accelerate_active(nullptr),
+	m_ocl_kernel_kick_block(nullptr),
+	m_ocl_kernel_accelerate_jerk(nullptr),
+	m_ocl_kernel_hermite_predict(nullptr),
+	m_ocl_kernel_hermite_correct(nullptr),
+	m_ocl_kernel_morton_keys(nullptr),
+	m_ocl_kernel_gather(nullptr),
+	m_ocl_kernel_gather_int(nullptr),
+	m_ocl_kernel_publish(nullptr),
+	m_ocl_local_work_size(1),
+	m_ocl_tuned_local_size(0),
+	m_ocl_unroll(1),
+	m_ocl_buffer_packed(nullptr),
+	m_ocl_buffer_pos(nullptr),
+	m_ocl_buffer_vel(nullptr),
+	m_ocl_buffer_jerk(nullptr),
+	m_ocl_buffer_pos_old(nullptr),
+	m_ocl_buffer_vel_old(nullptr),
+	m_ocl_buffer_acc_old(nullptr),
+	m_ocl_buffer_jerk_old(nullptr),
+	m_ocl_buffer_acc(nullptr),
+	m_ocl_tree_capacity(0),
+	m_ocl_buffer_node_com(nullptr),
+	m_ocl_buffer_node_quad_diag(nullptr),
+	m_ocl_buffer_node_quad_offdiag(nullptr),
+	m_ocl_buffer_node_link(nullptr),
+	m_ocl_buffer_body(nullptr),
+	m_ocl_buffer_level(nullptr),
+	m_ocl_buffer_active(nullptr),
+	m_ocl_buffer_num_active(nullptr),
+	m_ocl_buffer_key(nullptr),
+	m_ocl_buffer_order(nullptr)
+{
+}
+
+
+void Ocl_backend::release()
+{
+	if (m_ocl_cmd_queue != nullptr)
+	{
+		clFinish(m_ocl_cmd_queue);
+		clReleaseCommandQueue(m_ocl_cmd_queue);
+		m_ocl_cmd_queue = nullptr;
+	}
+
+	if (m_gl_sync_rendered != nullptr)
+	{
+		glDeleteSync(m_gl_sync_rendered);
+		m_gl_sync_rendered = nullptr;
+	}
+
+	if (m_ocl_event_positions != nullptr)
+	{
+		clReleaseEvent(m_ocl_event_positions);
+		m_ocl_event_positions = nullptr;
+	}
+
+	release_kernels();
+
+	for (auto& programs : m_ocl_programs)
+	{
+		clReleaseProgram(programs.second.main);
+		clReleaseProgram(programs.second.strict);
+	}
+
+	m_ocl_programs.clear();
+	m_ocl_options.clear();
+
+	for (cl_mem ocl_buffer_render : m_ocl_buffers_render)
+		clReleaseMemObject(ocl_buffer_render);
+
+	m_ocl_buffers_render.clear();
+
+	if (m_ocl_buffer_packed != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_packed);
+		m_ocl_buffer_packed = nullptr;
+	}
+
+	if (m_ocl_buffer_pos != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_pos);
+		m_ocl_buffer_pos = nullptr;
+	}
+
+	if (m_ocl_buffer_vel != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_vel);
+		m_ocl_buffer_vel = nullptr;
+	}
+
+	if (m_ocl_buffer_acc != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_acc);
+		m_ocl_buffer_acc = nullptr;
+	}
+
+	cl_mem* hermite_buffers[] = { &m_ocl_buffer_jerk, &m_ocl_buffer_pos_old, &m_ocl_buffer_vel_old, &m_ocl_buffer_acc_old, &m_ocl_buffer_jerk_old };
+
+	for (cl_mem* buffer : hermite_buffers)
+	{
+		if (*buffer != nullptr)
+		{
+			clReleaseMemObject(*buffer);
+			*buffer = nullptr;
+		}
+	}
+
+	release_tree_buffers();
+
+	if (m_ocl_buffer_body != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_body);
+		m_ocl_buffer_body = nullptr;
+	}
+
+	if (m_ocl_buffer_level != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_level);
+		m_ocl_buffer_level = nullptr;
+	}
+
+	if (m_ocl_buffer_active != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_active);
+		m_ocl_buffer_active = nullptr;
+	}
+
+	if (m_ocl_buffer_num_active != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_num_active);
+		m_ocl_buffer_num_active = nullptr;
+	}
+
+	if (m_ocl_buffer_key != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_key);
+		m_ocl_buffer_key = nullptr;
+	}
+
+	if (m_ocl_buffer_order != nullptr)
+	{
+		clReleaseMemObject(m_ocl_buffer_order);
+		m_ocl_buffer_order = nullptr;
+	}
+
+	if (m_ocl_context != nullptr)
+	{
+		clReleaseContext(m_ocl_context);
+		m_ocl_context = nullptr;
+	}
+}
+
+
+void Ocl_backend::release_kernels()
+{
+	if (m_ocl_kernel_drift != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_drift);
+		m_ocl_kernel_drift = nullptr;
+	}
+
+	if (m_ocl_kernel_accelerate != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_accelerate);
+		m_ocl_kernel_accelerate = nullptr;
+	}
+
+	if (m_ocl_kernel_accelerate_kahan != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_accelerate_kahan);
+		m_ocl_kernel_accelerate_kahan = nullptr;
+	}
+
+	if (m_ocl_kernel_accelerate_double != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_accelerate_double);
+		m_ocl_kernel_accelerate_double = nullptr;
+	}
+
+	if (m_ocl_kernel_kick != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_kick);
+		m_ocl_kernel_kick = nullptr;
+	}
+
+	if (m_ocl_kernel_accelerate_tree != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_accelerate_tree);
+		m_ocl_kernel_accelerate_tree = nullptr;
+	}
+
+	if (m_ocl_kernel_collect_active != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_collect_active);
+		m_ocl_kernel_collect_active = nullptr;
+	}
+
+	if (m_ocl_kernel_accelerate_active != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_accelerate_active);
+		m_ocl_kernel_accelerate_active = nullptr;
+	}
+
+	if (m_ocl_kernel_kick_block != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_kick_block);
+		m_ocl_kernel_kick_block = nullptr;
+	}
+
+	if (m_ocl_kernel_accelerate_jerk != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_accelerate_jerk);
+		m_ocl_kernel_accelerate_jerk = nullptr;
+	}
+
+	if (m_ocl_kernel_hermite_predict != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_hermite_predict);
+		m_ocl_kernel_hermite_predict = nullptr;
+	}
+
+	if (m_ocl_kernel_hermite_correct != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_hermite_correct);
+		m_ocl_kernel_hermite_correct = nullptr;
+	}
+
+	if (m_ocl_kernel_morton_keys != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_morton_keys);
+		m_ocl_kernel_morton_keys = nullptr;
+	}
+
+	if (m_ocl_kernel_gather != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_gather);
+		m_ocl_kernel_gather = nullptr;
+	}
+
+	if (m_ocl_kernel_gather_int != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_gather_int);
+		m_ocl_kernel_gather_int = nullptr;
+	}
+
+	if (m_ocl_kernel_publish != nullptr)
+	{
+		clReleaseKernel(m_ocl_kernel_publish);
+		m_ocl_kernel_publish = nullptr;
+	}
+}
+
+
+Ocl_backend::~Ocl_backend()
+{
+	release();
+}
+
+
+bool Ocl_backend::init(const Settings& settings, const GLuint* vbos, size_t num_vbos, const Vector4D* pos, const Vector4D* vel)
+{
+	m_settings = settings;
+	m_vbos.assign(vbos, vbos + num_vbos);
+	m_gl_thread = std::this_thread::get_id();
+
+	cl_uint ocl_num_platforms = 0;
+	clGetPlatformIDs(0, nullptr, &ocl_num_platforms);
+	if (ocl_num_platforms == 0) return false;
+
+	auto ocl_platforms = std::make_unique<cl_platform_id[]>(ocl_num_platforms);
+	clGetPlatformIDs(ocl_num_platforms, ocl_platforms.get(), nullptr);
+
+	// CPU devices rarely share OpenGL buffers, so their positions are copied to the VBO instead
+	m_interop = !m_cpu;
+
+	for (cl_uint i = 0; i < ocl_num_platforms; i++)
+	{
+		cl_context_properties ocl_gl_context_properties[] =
+		{
+			CL_GL_CONTEXT_KHR, reinterpret_cast<cl_context_properties>(wglGetCurrentContext()),
+			CL_WGL_HDC_KHR, reinterpret_cast<cl_context_properties>(wglGetCurrentDC()),
+			CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(ocl_platforms[i]),
+			0
+		};
+
+		cl_context_properties ocl_context_properties[] =
+		{
+			CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(ocl_platforms[i]),
+			0
+		};
+
+		cl_int ocl_err;
+		m_ocl_context = clCreateContextFromType(m_interop ? ocl_gl_context_properties : ocl_context_properties,
+			m_cpu ? CL_DEVICE_TYPE_CPU : CL_DEVICE_TYPE_GPU, nullptr, nullptr, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_context = nullptr;
+			continue;
+		}
+
+		size_t ocl_devices_size;
+		clGetContextInfo(m_ocl_context, CL_CONTEXT_DEVICES, 0, nullptr, &ocl_devices_size);
+		size_t ocl_num_devices = ocl_devices_size / sizeof(cl_device_id);
+		if (ocl_num_devices != 1)
+		{
+			release();
+			continue;
+		}
+
+		cl_device_id ocl_device;
+		clGetContextInfo(m_ocl_context, CL_CONTEXT_DEVICES, sizeof(cl_device_id), &ocl_device, nullptr);
+
+		// every stage names what it waits for, so devices that can run independent commands side by side may do so
+		cl_command_queue_properties ocl_queue_properties = 0;
+		clGetDeviceInfo(ocl_device, CL_DEVICE_QUEUE_PROPERTIES, sizeof(ocl_queue_properties), &ocl_queue_properties, nullptr);
+
+		m_ocl_cmd_queue = clCreateCommandQueue(m_ocl_context, ocl_device,
+			ocl_queue_properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_cmd_queue = nullptr;
+			release();
+			continue;
+		}
+
+		m_ocl_device = ocl_device;
+		load_tuning();
+
+		// with cl_khr_gl_event the queue can wait on a GL fence instead of the CPU calling glFinish
+		m_ocl_create_event_from_gl_sync = nullptr;
+
+		if (m_interop && (ocl_device_string(ocl_device, CL_DEVICE_EXTENSIONS).find("cl_khr_gl_event") != std::string::npos))
+			m_ocl_create_event_from_gl_sync = reinterpret_cast<Create_event_from_gl_sync>(
+				clGetExtensionFunctionAddressForPlatform(ocl_platforms[i], "clCreateEventFromGLsyncKHR"));
+
+		// every VBO of the ring is shared, so a step never writes the buffer that is being drawn
+		if (m_interop)
+		{
+			for (GLuint vbo : m_vbos)
+			{
+				cl_mem ocl_buffer_render = clCreateFromGLBuffer(m_ocl_context, CL_MEM_WRITE_ONLY, vbo, &ocl_err);
+				if (ocl_err != CL_SUCCESS) break;
+
+				m_ocl_buffers_render.push_back(ocl_buffer_render);
+			}
+		}
+		else if (m_packing != Packing::FLOAT)
+		{
+			m_ocl_buffer_packed = clCreateBuffer(m_ocl_context, CL_MEM_WRITE_ONLY, m_num * packed_size(m_packing), nullptr, &ocl_err);
+			if (ocl_err != CL_SUCCESS) m_ocl_buffer_packed = nullptr;
+		}
+
+		if (ocl_err != CL_SUCCESS)
+		{
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_pos = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+			m_num * m_vector_size, const_cast<void*>(stage_vectors(pos)), &ocl_err);
+
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_pos = nullptr;
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_vel = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+			m_num * m_vector_size, const_cast<void*>(stage_vectors(vel)), &ocl_err);
+
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_vel = nullptr;
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_jerk = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE, m_num * m_vector_size, nullptr, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_jerk = nullptr;
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_acc = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE, m_num * m_vector_size, nullptr, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_acc = nullptr;
+			release();
+			continue;
+		}
+
+		cl_mem* ocl_old_buffers[] = { &m_ocl_buffer_pos_old, &m_ocl_buffer_vel_old, &m_ocl_buffer_acc_old, &m_ocl_buffer_jerk_old };
+		bool ocl_old_allocated = true;
+
+		for (cl_mem* buffer : ocl_old_buffers)
+		{
+			*buffer = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE, m_num * m_vector_size, nullptr, &ocl_err);
+			if (ocl_err != CL_SUCCESS)
+			{
+				*buffer = nullptr;
+				ocl_old_allocated = false;
+				break;
+			}
+		}
+
+		if (!ocl_old_allocated)
+		{
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_body = clCreateBuffer(m_ocl_context, CL_MEM_READ_ONLY, m_num * sizeof(cl_int), nullptr, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_body = nullptr;
+			release();
+			continue;
+		}
+
+		auto ocl_level = std::make_unique<cl_int[]>(m_num);
+
+		m_ocl_buffer_level = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+			m_num * sizeof(cl_int), ocl_level.get(), &ocl_err);
+
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_level = nullptr;
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_active = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE, m_num * sizeof(cl_uint), nullptr, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_active = nullptr;
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_num_active = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE, sizeof(cl_uint), nullptr, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_num_active = nullptr;
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_key = clCreateBuffer(m_ocl_context, CL_MEM_WRITE_ONLY, m_num * sizeof(cl_uint), nullptr, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_key = nullptr;
+			release();
+			continue;
+		}
+
+		m_ocl_buffer_order = clCreateBuffer(m_ocl_context, CL_MEM_READ_ONLY, m_num * sizeof(cl_int), nullptr, &ocl_err);
+		if (ocl_err != CL_SUCCESS)
+		{
+			m_ocl_buffer_order = nullptr;
+			release();
+			continue;
+		}
+
+		if (!specialise(m_settings))
+		{
+			release();
+			continue;
+		}
+
+
+		for (GLsizei i = 0; i < m_num; i++)
+			m_star_host[i] = i;
+
+		m_acc_valid = false;
+		m_jerk_valid = false;
+		m_steps_since_reorder = 0;
+		return true;
+	}
+
+	return false;
+}
+
+
+std::string Ocl_backend::build_options(const Settings& settings) const
+{
+	// hex floats carry the exact values, so equal options strings mean equal programs
+	char ocl_defines[256];
+	std::snprintf(ocl_defines, sizeof(ocl_defines), "-D MASS=%af -D RADIUS=%af -D REPULSION=%af -D SNORM16_SCALE=%af -D UNROLL=%d",
+		settings.mass, settings.radius, settings.repulsion, snorm16_scale, m_ocl_unroll);
+
+	std::string ocl_options = ocl_defines;
+
+	if (m_precision == Precision::DOUBLE)
+		ocl_options += " -D PRECISION_DOUBLE";
+	else if (m_precision == Precision::MIXED)
+		ocl_options += " -D PRECISION_MIXED";
+
+	return ocl_options;
+}
+
+
+bool Ocl_backend::specialise(const Settings& settings)
+{
+	const std::string ocl_options = build_options(settings);
+	if ((ocl_options == m_ocl_options) && (m_ocl_kernel_drift != nullptr)) return true;
+
+	auto programs = m_ocl_programs.find(ocl_options);
+
+	if (programs == m_ocl_programs.end())
+	{
+		const std::string log_index = std::to_string(m_ocl_programs.size());
+
+		cl_program ocl_program = build_program(m_ocl_device, ("-cl-fast-relaxed-math " + ocl_options).c_str(),
+			"ocl_build_log_" + log_index + ".txt");
+
+		if (ocl_program == nullptr) return false;
+
+		// fast relaxed math may reassociate the Kahan compensation away, so the accumulating kernels get a strict build
+		cl_program ocl_program_strict = build_program(m_ocl_device, ocl_options.c_str(), "ocl_build_log_strict_" + log_index + ".txt");
+		if (ocl_program_strict == nullptr)
+		{
+			clReleaseProgram(ocl_program);
+			return false;
+		}
+
+		programs = m_ocl_programs.emplace(ocl_options, Programs{ ocl_program, ocl_program_strict }).first;
+	}
+
+	release_kernels();
+	m_ocl_options.clear();
+
+	cl_program ocl_program = programs->second.main;
+	cl_program ocl_program_strict = programs->second.strict;
+	cl_int ocl_err;
+
+	m_ocl_kernel_accelerate_kahan = clCreateKernel(ocl_program_strict, "accelerate_kahan", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_accelerate_kahan = nullptr;
+
+	m_ocl_kernel_accelerate_double = clCreateKernel(ocl_program_strict, "accelerate_double", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_accelerate_double = nullptr;
+
+	m_ocl_kernel_drift = clCreateKernel(ocl_program, "drift", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_drift = nullptr;
+
+	m_ocl_kernel_accelerate = clCreateKernel(ocl_program, "accelerate", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_accelerate = nullptr;
+
+	m_ocl_kernel_kick = clCreateKernel(ocl_program, "kick", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_kick = nullptr;
+
+	m_ocl_kernel_accelerate_tree = clCreateKernel(ocl_program, "accelerate_tree", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_accelerate_tree = nullptr;
+
+	m_ocl_kernel_collect_active = clCreateKernel(ocl_program, "collect_active", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_collect_active = nullptr;
+
+	m_ocl_kernel_accelerate_active = clCreateKernel(ocl_program, "accelerate_active", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_accelerate_active = nullptr;
+
+	m_ocl_kernel_kick_block = clCreateKernel(ocl_program, "kick_block", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_kick_block = nullptr;
+
+	m_ocl_kernel_accelerate_jerk = clCreateKernel(ocl_program, "accelerate_jerk", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_accelerate_jerk = nullptr;
+
+	m_ocl_kernel_hermite_predict = clCreateKernel(ocl_program, "hermite_predict", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_hermite_predict = nullptr;
+
+	m_ocl_kernel_hermite_correct = clCreateKernel(ocl_program, "hermite_correct", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_hermite_correct = nullptr;
+
+	m_ocl_kernel_morton_keys = clCreateKernel(ocl_program, "morton_keys", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_morton_keys = nullptr;
+
+	m_ocl_kernel_gather = clCreateKernel(ocl_program, "gather", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_gather = nullptr;
+
+	m_ocl_kernel_gather_int = clCreateKernel(ocl_program, "gather_int", &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_gather_int = nullptr;
+
+	const char* ocl_publish = (m_packing == Packing::HALF) ? "publish_half" :
+		((m_packing == Packing::SNORM16) ? "publish_snorm16" : "publish");
+
+	m_ocl_kernel_publish = clCreateKernel(ocl_program, ocl_publish, &ocl_err);
+	if (ocl_err != CL_SUCCESS) m_ocl_kernel_publish = nullptr;
+
+	if ((m_ocl_kernel_drift == nullptr) || (m_ocl_kernel_accelerate == nullptr) ||
+		(m_ocl_kernel_accelerate_kahan == nullptr) || (m_ocl_kernel_kick == nullptr) ||
+		(m_ocl_kernel_accelerate_tree == nullptr) || (m_ocl_kernel_collect_active == nullptr) ||
+		(m_ocl_kernel_accelerate_active == nullptr) || (m_ocl_kernel_kick_block == nullptr) ||
+		(m_ocl_kernel_accelerate_jerk == nullptr) || (m_ocl_kernel_hermite_predict == nullptr) ||
+		(m_ocl_kernel_hermite_correct == nullptr) || (m_ocl_kernel_morton_keys == nullptr) ||
+		(m_ocl_kernel_gather == nullptr) || (m_ocl_kernel_gather_int == nullptr) || (m_ocl_kernel_publish == nullptr))
+		return false;
+
+	// every kernel launched with m_ocl_local_work_size bounds it, a tuned size included
+	cl_kernel ocl_local_kernels[] = { m_ocl_kernel_accelerate, m_ocl_kernel_accelerate_kahan, m_ocl_kernel_accelerate_double,
+		m_ocl_kernel_accelerate_jerk, m_ocl_kernel_accelerate_active };
+
+	size_t ocl_max_work_size = ocl_max_local_work_size;
+
+	for (cl_kernel kernel : ocl_local_kernels)
+	{
+		size_t work_size = ocl_max_work_size;
+
+		if ((kernel != nullptr) &&
+			(clGetKernelWorkGroupInfo(kernel, m_ocl_device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &work_size, nullptr) != CL_SUCCESS))
+			return false;
+
+		if (work_size < ocl_max_work_size)
+			ocl_max_work_size = work_size;
+	}
+
+	if ((m_ocl_tuned_local_size != 0) && (m_ocl_tuned_local_size <= ocl_max_work_size))
+		m_ocl_local_work_size = m_ocl_tuned_local_size;
+	else
+		m_ocl_local_work_size = ocl_max_work_size;
+
+	const cl_uint ocl_num = static_cast<cl_uint>(m_num);
+
+	if ((clSetKernelArg(m_ocl_kernel_drift, 0, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_drift, 1, sizeof(cl_mem), &m_ocl_buffer_vel) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_drift, 2, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate, 0, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate, 1, sizeof(cl_mem), &m_ocl_buffer_acc) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate, 2, m_ocl_local_work_size * m_vector_size, nullptr) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate, 3, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_kahan, 0, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_kahan, 1, sizeof(cl_mem), &m_ocl_buffer_acc) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_kahan, 2, m_ocl_local_work_size * m_vector_size, nullptr) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_kahan, 3, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick, 0, sizeof(cl_mem), &m_ocl_buffer_vel) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick, 1, sizeof(cl_mem), &m_ocl_buffer_acc) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick, 2, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 0, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 1, sizeof(cl_mem), &m_ocl_buffer_acc) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 6, sizeof(cl_mem), &m_ocl_buffer_body) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 9, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_collect_active, 0, sizeof(cl_mem), &m_ocl_buffer_level) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_collect_active, 1, sizeof(cl_mem), &m_ocl_buffer_active) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_collect_active, 2, sizeof(cl_mem), &m_ocl_buffer_num_active) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_collect_active, 5, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_active, 0, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_active, 1, sizeof(cl_mem), &m_ocl_buffer_acc) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_active, 2, m_ocl_local_work_size * m_vector_size, nullptr) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_active, 3, sizeof(cl_mem), &m_ocl_buffer_active) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_active, 4, sizeof(cl_mem), &m_ocl_buffer_num_active) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_active, 5, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 0, sizeof(cl_mem), &m_ocl_buffer_vel) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 1, sizeof(cl_mem), &m_ocl_buffer_acc) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 2, sizeof(cl_mem), &m_ocl_buffer_level) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 3, sizeof(cl_mem), &m_ocl_buffer_active) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 4, sizeof(cl_mem), &m_ocl_buffer_num_active) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_jerk, 0, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_jerk, 1, sizeof(cl_mem), &m_ocl_buffer_vel) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_jerk, 2, sizeof(cl_mem), &m_ocl_buffer_acc) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_jerk, 3, sizeof(cl_mem), &m_ocl_buffer_jerk) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_jerk, 4, m_ocl_local_work_size * m_vector_size, nullptr) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_jerk, 5, m_ocl_local_work_size * m_vector_size, nullptr) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_jerk, 6, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_morton_keys, 0, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_morton_keys, 1, sizeof(cl_mem), &m_ocl_buffer_key) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_morton_keys, 2, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_gather, 2, sizeof(cl_mem), &m_ocl_buffer_order) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_gather, 3, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_gather_int, 2, sizeof(cl_mem), &m_ocl_buffer_order) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_gather_int, 3, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_publish, 1, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_publish, 2, sizeof(cl_uint), &ocl_num) != CL_SUCCESS))
+		return false;
+
+	cl_mem ocl_hermite_args[] = { m_ocl_buffer_pos, m_ocl_buffer_vel, m_ocl_buffer_acc, m_ocl_buffer_jerk,
+		m_ocl_buffer_pos_old, m_ocl_buffer_vel_old, m_ocl_buffer_acc_old, m_ocl_buffer_jerk_old };
+	bool ocl_hermite_set = true;
+
+	for (cl_uint a = 0; a < 8; a++)
+	{
+		if ((clSetKernelArg(m_ocl_kernel_hermite_predict, a, sizeof(cl_mem), &ocl_hermite_args[a]) != CL_SUCCESS) ||
+			(clSetKernelArg(m_ocl_kernel_hermite_correct, a, sizeof(cl_mem), &ocl_hermite_args[a]) != CL_SUCCESS))
+			ocl_hermite_set = false;
+	}
+
+	if (!ocl_hermite_set ||
+		(clSetKernelArg(m_ocl_kernel_hermite_predict, 8, sizeof(cl_uint), &ocl_num) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_hermite_correct, 8, sizeof(cl_uint), &ocl_num) != CL_SUCCESS))
+		return false;
+
+	if ((m_ocl_kernel_accelerate_double != nullptr) &&
+		((clSetKernelArg(m_ocl_kernel_accelerate_double, 0, sizeof(cl_mem), &m_ocl_buffer_pos) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_double, 1, sizeof(cl_mem), &m_ocl_buffer_acc) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_double, 2, m_ocl_local_work_size * m_vector_size, nullptr) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_double, 3, sizeof(cl_uint), &ocl_num) != CL_SUCCESS)))
+		return false;
+
+	m_ocl_options = ocl_options;
+	m_acc_valid = false;
+	m_jerk_valid = false;
+	return true;
+}
+
+
+std::string Ocl_backend::binary_key(cl_device_id ocl_device, const char* options) const
+{
+	return ocl_device_string(ocl_device, CL_DEVICE_NAME) + '\n' + ocl_device_string(ocl_device, CL_DRIVER_VERSION) + '\n' +
+		options + '\n' + std::to_string(Utils::hash(ocl_src_stars));
+}
+
+
+cl_program Ocl_backend::load_binary(cl_device_id ocl_device, const std::string& key)
+{
+	std::ifstream file(ocl_binary_file(key), std::ios::binary);
+	if (!file) return nullptr;
+
+	// the file starts with the full key, so a hash collision or a different driver reads as a miss
+	std::string file_key;
+	std::getline(file, file_key, '\0');
+	if (file_key != key) return nullptr;
+
+	const std::vector<unsigned char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (binary.empty()) return nullptr;
+
+	const size_t binary_size = binary.size();
+	const unsigned char* binary_data = binary.data();
+	cl_int ocl_binary_status;
+	cl_int ocl_err;
+
+	cl_program ocl_program = clCreateProgramWithBinary(m_ocl_context, 1, &ocl_device, &binary_size, &binary_data,
+		&ocl_binary_status, &ocl_err);
+
+	if (ocl_err != CL_SUCCESS) return nullptr;
+
+	if (ocl_binary_status != CL_SUCCESS)
+	{
+		clReleaseProgram(ocl_program);
+		return nullptr;
+	}
+
+	return ocl_program;
+}
+
+
+void Ocl_backend::store_binary(cl_program ocl_program, const std::string& key) const
+{
+	size_t binary_size = 0;
+	if ((clGetProgramInfo(ocl_program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binary_size, nullptr) != CL_SUCCESS) ||
+		(binary_size == 0))
+		return;
+
+	auto binary = std::make_unique<unsigned char[]>(binary_size);
+	unsigned char* binary_data = binary.get();
+	if (clGetProgramInfo(ocl_program, CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binary_data, nullptr) != CL_SUCCESS) return;
+
+	// a private temporary is renamed over the cache, so other runs never load a partly written binary
+	const std::string target = ocl_binary_file(key);
+	const std::string temporary = target + '.' + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(key.c_str(), key.size() + 1);
+		file.write(reinterpret_cast<const char*>(binary_data), binary_size);
+
+		if (!file.flush())
+		{
+			file.close();
+			std::remove(temporary.c_str());
+			return;
+		}
+	}
+
+	// std::rename does not replace an existing file on Windows
+	if (std::rename(temporary.c_str(), target.c_str()) != 0)
+	{
+		std::remove(target.c_str());
+
+		if (std::rename(temporary.c_str(), target.c_str()) != 0)
+			std::remove(temporary.c_str());
+	}
+}
+
+
+std::string Ocl_backend::tuning_file() const
+{
+	// a size tuned for float tiles may not fit double tiles in local memory, so each precision is tuned on its own
+	const std::string device = ocl_device_string(m_ocl_device, CL_DEVICE_NAME) + '\n' + ocl_device_string(m_ocl_device, CL_DRIVER_VERSION) +
+		'\n' + Backend::name(m_precision);
+
+	char name[64];
+	std::snprintf(name, sizeof(name), "ocl_tuning_%016llx.txt", static_cast<unsigned long long>(Utils::hash(device)));
+	return name;
+}
+
+
+void Ocl_backend::load_tuning()
+{
+	m_ocl_tuned_local_size = 0;
+	m_ocl_unroll = 1;
+
+	std::ifstream file(tuning_file());
+	std::string name;
+	size_t local_size = 0;
+	int unroll = 1;
+
+	while (file >> name)
+	{
+		if (name == "local_size")
+			file >> local_size;
+		else if (name == "unroll")
+			file >> unroll;
+	}
+
+	if ((local_size > 0) && (unroll > 0))
+	{
+		m_ocl_tuned_local_size = local_size;
+		m_ocl_unroll = unroll;
+	}
+}
+
+
+void Ocl_backend::store_tuning() const
+{
+	std::ofstream file(tuning_file(), std::ios::trunc);
+	file << "local_size " << m_ocl_tuned_local_size << std::endl;
+	file << "unroll " << m_ocl_unroll << std::endl;
+}
+
+
+double Ocl_backend::time_force_kernel(unsigned repeats)
+{
+	cl_event ocl_event_started;
+	begin_commands(&ocl_event_started);
+
+	// the first run absorbs lazy compilation and cache warm-up
+	enqueue_kernel(m_ocl_kernel_accelerate, &m_ocl_local_work_size, 1, &ocl_event_started, nullptr);
+	check(clFinish(m_ocl_cmd_queue), "OpenCL cannot finish.");
+
+	const auto start = std::chrono::steady_clock::now();
+
+	// the runs are chained, so an out-of-order queue cannot overlap them
+	cl_event ocl_event_timed;
+	begin_commands(&ocl_event_timed);
+
+	for (unsigned r = 0; r < repeats; r++)
+	{
+		cl_event ocl_event_run;
+		enqueue_kernel(m_ocl_kernel_accelerate, &m_ocl_local_work_size, 1, &ocl_event_timed, &ocl_event_run);
+		ocl_event_timed = ocl_event_run;
+	}
+
+	check(clFinish(m_ocl_cmd_queue), "OpenCL cannot finish.");
+	const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+	end_commands(ocl_event_timed);
+	return time;
+}
+
+
+cl_program Ocl_backend::build_program(cl_device_id ocl_device, const char* options, const std::string& log_name)
+{
+	const std::string key = binary_key(ocl_device, options);
+	cl_program ocl_program = load_binary(ocl_device, key);
+
+	if (ocl_program != nullptr)
+	{
+		if (clBuildProgram(ocl_program, 1, &ocl_device, options, nullptr, nullptr) == CL_SUCCESS)
+			return ocl_program;
+
+		// a binary the driver no longer accepts is rebuilt from source and overwritten below
+		clReleaseProgram(ocl_program);
+	}
+
+	cl_int ocl_err;
+	ocl_program = clCreateProgramWithSource(m_ocl_context, 1, &ocl_src_stars, nullptr, &ocl_err);
+	if (ocl_err != CL_SUCCESS) return nullptr;
+
+	ocl_err = clBuildProgram(ocl_program, 1, &ocl_device, options, nullptr, nullptr);
+
+#ifdef DEBUG
+	size_t log_str_size;
+	clGetProgramBuildInfo(ocl_program, ocl_device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_str_size);
+
+	auto log_str = std::make_unique<char[]>(log_str_size);
+	clGetProgramBuildInfo(ocl_program, ocl_device, CL_PROGRAM_BUILD_LOG, log_str_size, log_str.get(), nullptr);
+
+	std::ofstream log_file(log_name);
+	log_file << log_str.get();
+	log_file.close();
+#else
+	static_cast<void>(log_name);
+#endif
+
+	if (ocl_err != CL_SUCCESS)
+	{
+		clReleaseProgram(ocl_program);
+		return nullptr;
+	}
+
+	store_binary(ocl_program, key);
+	return ocl_program;
+}
+
+
+cl_kernel Ocl_backend::accumulating_kernel() const
+{
+	switch (m_settings.accumulation)
+	{
+	case Settings::Accumulation::DOUBLE:
+		// devices without cl_khr_fp64 fall back to compensated float
+		return (m_ocl_kernel_accelerate_double != nullptr) ? m_ocl_kernel_accelerate_double : m_ocl_kernel_accelerate_kahan;
+
+	case Settings::Accumulation::KAHAN:
+		return m_ocl_kernel_accelerate_kahan;
+
+	default:
+		return m_ocl_kernel_accelerate;
+	}
+}
+
+
+void Ocl_backend::enqueue_kernel(cl_kernel kernel, const size_t* local_work_size,
+	cl_uint num_wait_events, const cl_event* wait_events, cl_event* event)
+{
+	size_t global_work_size = m_num;
+
+	if (local_work_size != nullptr)
+		global_work_size = ((m_num + *local_work_size - 1) / *local_work_size) * *local_work_size;
+
+	cl_int ocl_err = clEnqueueNDRangeKernel(m_ocl_cmd_queue, kernel, 1, nullptr, &global_work_size, local_work_size,
+		num_wait_events, wait_events, event);
+
+	for (cl_uint i = 0; i < num_wait_events; i++)
+		clReleaseEvent(wait_events[i]);
+
+	if (ocl_err != CL_SUCCESS)
+	{
+		release();
+		throw std::runtime_error("OpenCL cannot run kernel.");
+	}
+}
+
+
+void Ocl_backend::check(cl_int ocl_err, const char* message)
+{
+	if (ocl_err != CL_SUCCESS)
+	{
+		// the GL sync and shared buffers belong to the thread with the GL context, which releases a backend that failed elsewhere
+		if (std::this_thread::get_id() == m_gl_thread)
+			release();
+
+		throw std::runtime_error(message);
+	}
+}
+
+
+void Ocl_backend::begin_commands(cl_event* event)
+{
+	if (m_ocl_cmd_queue == nullptr) throw std::runtime_error("Not initialised.");
+
+	check(clEnqueueMarkerWithWaitList(m_ocl_cmd_queue, 0, nullptr, event), "OpenCL cannot enqueue marker.");
+}
+
+
+void Ocl_backend::end_commands(cl_event wait_event)
+{
+	if (wait_event != nullptr)
+		clReleaseEvent(wait_event);
+
+	// nothing waits here; the next begin_commands() marker waits for everything enqueued so far
+	check(clFlush(m_ocl_cmd_queue), "OpenCL cannot flush.");
+}
+
+
+void Ocl_backend::track_positions(cl_event event)
+{
+	clRetainEvent(event);
+
+	if (m_ocl_event_positions != nullptr)
+		clReleaseEvent(m_ocl_event_positions);
+
+	m_ocl_event_positions = event;
+}
+
+
+void Ocl_backend::positions_written(cl_event* event)
+{
+	// readers of the positions wait for their last writer only, so they overlap the rest of the step
+	if (m_ocl_event_positions == nullptr)
+	{
+		begin_commands(event);
+		return;
+	}
+
+	clRetainEvent(m_ocl_event_positions);
+	*event = m_ocl_event_positions;
+}
+
+
+void Ocl_backend::acquire_render(size_t slot, cl_event* event)
+{
+	const bool gl_sync = (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+	cl_event ocl_event_rendered = nullptr;
+
+	if (m_gl_sync_rendered != nullptr)
+	{
+		glDeleteSync(m_gl_sync_rendered);
+		m_gl_sync_rendered = nullptr;
+	}
+
+	if (gl_sync && (m_ocl_create_event_from_gl_sync != nullptr))
+	{
+		m_gl_sync_rendered = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		cl_int ocl_err;
+		ocl_event_rendered = m_ocl_create_event_from_gl_sync(m_ocl_context, m_gl_sync_rendered, &ocl_err);
+		if (ocl_err != CL_SUCCESS) ocl_event_rendered = nullptr;
+	}
+
+	if (ocl_event_rendered == nullptr)
+	{
+		// fallback: block only until the GL commands issued so far have run, or drain GL without sync objects
+		if (gl_sync)
+		{
+			GLsync gl_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glClientWaitSync(gl_fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(gl_fence);
+		}
+		else
+		{
+			glFinish();
+		}
+	}
+
+	const cl_uint num_wait_events = (ocl_event_rendered != nullptr) ? 1 : 0;
+	const cl_event* wait_events = (ocl_event_rendered != nullptr) ? &ocl_event_rendered : nullptr;
+
+	cl_int ocl_err = clEnqueueAcquireGLObjects(m_ocl_cmd_queue, 1, &m_ocl_buffers_render[slot], num_wait_events, wait_events, event);
+
+	if (ocl_event_rendered != nullptr)
+		clReleaseEvent(ocl_event_rendered);
+
+	check(ocl_err, "OpenCL cannot acquire OpenGL buffer.");
+}
+
+
+void Ocl_backend::release_render(size_t slot, cl_event wait_event)
+{
+	cl_event ocl_event_released;
+	cl_int ocl_err = clEnqueueReleaseGLObjects(m_ocl_cmd_queue, 1, &m_ocl_buffers_render[slot], 1, &wait_event, &ocl_event_released);
+
+	clReleaseEvent(wait_event);
+	check(ocl_err, "OpenCL cannot release OpenGL buffer.");
+	check(clFlush(m_ocl_cmd_queue), "OpenCL cannot flush.");
+
+	GLsync gl_sync_computed = GLEW_ARB_cl_event ? glCreateSyncFromCLeventARB(m_ocl_context, ocl_event_released, 0) : nullptr;
+
+	if (gl_sync_computed != nullptr)
+	{
+		// the GL server waits for the queue, so drawing this VBO is ordered after the publish without stalling the CPU
+		glWaitSync(gl_sync_computed, 0, GL_TIMEOUT_IGNORED);
+		glDeleteSync(gl_sync_computed);
+	}
+	else
+	{
+		ocl_err = clWaitForEvents(1, &ocl_event_released);
+	}
+
+	clReleaseEvent(ocl_event_released);
+	check(ocl_err, "OpenCL cannot wait for positions.");
+}
+
+
+void Ocl_backend::release_tree_buffers()
+{
+	cl_mem* buffers[] = { &m_ocl_buffer_node_com, &m_ocl_buffer_node_quad_diag, &m_ocl_buffer_node_quad_offdiag, &m_ocl_buffer_node_link };
+
+	for (cl_mem* buffer : buffers)
+	{
+		if (*buffer != nullptr)
+		{
+			clReleaseMemObject(*buffer);
+			*buffer = nullptr;
+		}
+	}
+
+	m_ocl_tree_capacity = 0;
+}
+
+
+void Ocl_backend::reserve_tree_buffers(size_t num_nodes)
+{
+	if (num_nodes <= m_ocl_tree_capacity) return;
+
+	release_tree_buffers();
+
+	const size_t capacity = num_nodes + num_nodes / 2;
+	cl_int ocl_err;
+
+	m_ocl_buffer_node_com = clCreateBuffer(m_ocl_context, CL_MEM_READ_ONLY, capacity * sizeof(Vector4D), nullptr, &ocl_err);
+	check(ocl_err, "OpenCL cannot allocate tree buffers.");
+
+	m_ocl_buffer_node_quad_diag = clCreateBuffer(m_ocl_context, CL_MEM_READ_ONLY, capacity * sizeof(Vector4D), nullptr, &ocl_err);
+	check(ocl_err, "OpenCL cannot allocate tree buffers.");
+
+	m_ocl_buffer_node_quad_offdiag = clCreateBuffer(m_ocl_context, CL_MEM_READ_ONLY, capacity * sizeof(Vector4D), nullptr, &ocl_err);
+	check(ocl_err, "OpenCL cannot allocate tree buffers.");
+
+	m_ocl_buffer_node_link = clCreateBuffer(m_ocl_context, CL_MEM_READ_ONLY, capacity * sizeof(Octree::Link), nullptr, &ocl_err);
+	check(ocl_err, "OpenCL cannot allocate tree buffers.");
+
+	m_ocl_tree_capacity = capacity;
+}
+
+
+const void* Ocl_backend::stage_vectors(const Vector4D* src)
+{
+	if (m_precision != Precision::DOUBLE) return src;
+
+	for (GLsizei i = 0; i < m_num; i++)
+	{
+		m_stage_host[i].s[0] = src[i].x;
+		m_stage_host[i].s[1] = src[i].y;
+		m_stage_host[i].s[2] = src[i].z;
+		m_stage_host[i].s[3] = src[i].w;
+	}
+
+	return m_stage_host.get();
+}
+
+
+void Ocl_backend::read_vectors(cl_mem buffer, Vector4D* dst, cl_event wait_event, const char* message)
+{
+	const cl_uint num_wait_events = (wait_event != nullptr) ? 1 : 0;
+	const cl_event* wait_events = (wait_event != nullptr) ? &wait_event : nullptr;
+	void* ocl_dst = (m_precision == Precision::DOUBLE) ? static_cast<void*>(m_stage_host.get()) : dst;
+
+	cl_int ocl_err = clEnqueueReadBuffer(m_ocl_cmd_queue, buffer, CL_TRUE, 0, m_num * m_vector_size,
+		ocl_dst, num_wait_events, wait_events, nullptr);
+
+	if (wait_event != nullptr)
+		clReleaseEvent(wait_event);
+
+	check(ocl_err, message);
+
+	if (m_precision == Precision::DOUBLE)
+	{
+		for (GLsizei i = 0; i < m_num; i++)
+		{
+			dst[i].x = static_cast<float>(m_stage_host[i].s[0]);
+			dst[i].y = static_cast<float>(m_stage_host[i].s[1]);
+			dst[i].z = static_cast<float>(m_stage_host[i].s[2]);
+			dst[i].w = static_cast<float>(m_stage_host[i].s[3]);
+		}
+	}
+}
+
+
+void Ocl_backend::write_vectors(cl_mem buffer, const Vector4D* src, cl_event* event, const char* message)
+{
+	// the staging copy is reused by the next transfer, so a converted write has to complete first
+	const cl_bool blocking = (m_precision == Precision::DOUBLE) ? CL_TRUE : CL_FALSE;
+
+	check(clEnqueueWriteBuffer(m_ocl_cmd_queue, buffer, blocking, 0, m_num * m_vector_size,
+		stage_vectors(src), 0, nullptr, event), message);
+}
+
+
+void Ocl_backend::read_positions(cl_event wait_event)
+{
+	read_vectors(m_ocl_buffer_pos, m_pos_host.get(), wait_event, "OpenCL cannot read positions.");
+}
+
+
+void Ocl_backend::unpermute(Vector4D* data)
+{
+	// results leave the backend in the order the stars were loaded, however often they were reordered since
+	if (m_reorder_count == 0) return;
+
+	std::copy(data, data + m_num, m_slot_host.get());
+
+	for (GLsizei i = 0; i < m_num; i++)
+		data[m_star_host[i]] = m_slot_host[i];
+}
+
+
+void Ocl_backend::accelerate(cl_event wait_event, cl_event* event)
+{
+	switch (m_settings.solver)
+	{
+	case Settings::Solver::BARNES_HUT:
+		accelerate_tree(wait_event, event);
+		break;
+
+	case Settings::Solver::BARNES_HUT_HOST:
+	case Settings::Solver::FMM:
+	case Settings::Solver::PARTICLE_MESH:
+	case Settings::Solver::TREE_PM:
+	case Settings::Solver::DIRECT_SYMMETRIC:
+		accelerate_host(wait_event, event);
+		break;
+
+	default:
+		enqueue_kernel(accumulating_kernel(), &m_ocl_local_work_size, 1, &wait_event, event);
+		break;
+	}
+}
+
+
+void Ocl_backend::accelerate_host(cl_event wait_event, cl_event* event)
+{
+	read_positions(wait_event);
+	m_solvers.accelerations(m_pos_host.get(), m_num, m_settings, m_acc_host.get());
+
+	write_vectors(m_ocl_buffer_acc, m_acc_host.get(), event, "OpenCL cannot write accelerations.");
+}
+
+
+void Ocl_backend::accelerate_tree(cl_event wait_event, cl_event* event)
+{
+	read_positions(wait_event);
+
+	Octree& octree = m_solvers.octree();
+	octree.build(Bodies(m_pos_host.get(), nullptr), m_num, m_settings.mass);
+
+	const size_t num_nodes = octree.num_nodes();
+	reserve_tree_buffers(num_nodes);
+
+	cl_event ocl_events_written[5];
+
+	check(clEnqueueWriteBuffer(m_ocl_cmd_queue, m_ocl_buffer_node_com, CL_FALSE, 0, num_nodes * sizeof(Vector4D),
+		octree.com(), 0, nullptr, &ocl_events_written[0]), "OpenCL cannot write tree.");
+
+	check(clEnqueueWriteBuffer(m_ocl_cmd_queue, m_ocl_buffer_node_quad_diag, CL_FALSE, 0, num_nodes * sizeof(Vector4D),
+		octree.quad_diag(), 0, nullptr, &ocl_events_written[1]), "OpenCL cannot write tree.");
+
+	check(clEnqueueWriteBuffer(m_ocl_cmd_queue, m_ocl_buffer_node_quad_offdiag, CL_FALSE, 0, num_nodes * sizeof(Vector4D),
+		octree.quad_offdiag(), 0, nullptr, &ocl_events_written[2]), "OpenCL cannot write tree.");
+
+	check(clEnqueueWriteBuffer(m_ocl_cmd_queue, m_ocl_buffer_node_link, CL_FALSE, 0, num_nodes * sizeof(Octree::Link),
+		octree.link(), 0, nullptr, &ocl_events_written[3]), "OpenCL cannot write tree.");
+
+	check(clEnqueueWriteBuffer(m_ocl_cmd_queue, m_ocl_buffer_body, CL_FALSE, 0, m_num * sizeof(cl_int),
+		octree.body(), 0, nullptr, &ocl_events_written[4]), "OpenCL cannot write tree.");
+
+	const cl_float ocl_opening_angle = m_settings.opening_angle;
+	const cl_int ocl_quadrupole = m_settings.quadrupole ? 1 : 0;
+
+	if ((clSetKernelArg(m_ocl_kernel_accelerate_tree, 2, sizeof(cl_mem), &m_ocl_buffer_node_com) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 3, sizeof(cl_mem), &m_ocl_buffer_node_quad_diag) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 4, sizeof(cl_mem), &m_ocl_buffer_node_quad_offdiag) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 5, sizeof(cl_mem), &m_ocl_buffer_node_link) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 7, sizeof(cl_float), &ocl_opening_angle) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_accelerate_tree, 8, sizeof(cl_int), &ocl_quadrupole) != CL_SUCCESS))
+	{
+		for (cl_event ocl_event : ocl_events_written)
+			clReleaseEvent(ocl_event);
+
+		release();
+		throw std::runtime_error("OpenCL cannot set kernel arguments.");
+	}
+
+	enqueue_kernel(m_ocl_kernel_accelerate_tree, nullptr, 5, ocl_events_written, event);
+}
+
+
+void Ocl_backend::drift(float time_step, cl_event wait_event, cl_event* event)
+{
+	const cl_float ocl_time_step = time_step;
+
+	if (clSetKernelArg(m_ocl_kernel_drift, 3, sizeof(cl_float), &ocl_time_step) != CL_SUCCESS)
+	{
+		clReleaseEvent(wait_event);
+		release();
+		throw std::runtime_error("OpenCL cannot set kernel arguments.");
+	}
+
+	enqueue_kernel(m_ocl_kernel_drift, nullptr, 1, &wait_event, event);
+	track_positions(*event);
+}
+
+
+void Ocl_backend::kick(float time_step, cl_event wait_event, cl_event* event)
+{
+	const cl_float ocl_time_step = time_step;
+
+	if (clSetKernelArg(m_ocl_kernel_kick, 3, sizeof(cl_float), &ocl_time_step) != CL_SUCCESS)
+	{
+		clReleaseEvent(wait_event);
+		release();
+		throw std::runtime_error("OpenCL cannot set kernel arguments.");
+	}
+
+	enqueue_kernel(m_ocl_kernel_kick, nullptr, 1, &wait_event, event);
+}
+
+
+void Ocl_backend::collect_active(unsigned boundary, cl_event wait_event, cl_event* event)
+{
+	static const cl_uint ocl_zero = 0;
+	const cl_uint ocl_boundary = boundary;
+	const cl_int ocl_max_level = m_settings.block_levels;
+
+	cl_event ocl_event_reset;
+	cl_int ocl_err = clEnqueueWriteBuffer(m_ocl_cmd_queue, m_ocl_buffer_num_active, CL_FALSE, 0, sizeof(cl_uint),
+		&ocl_zero, 1, &wait_event, &ocl_event_reset);
+
+	clReleaseEvent(wait_event);
+	check(ocl_err, "OpenCL cannot reset active list.");
+
+	if ((clSetKernelArg(m_ocl_kernel_collect_active, 3, sizeof(cl_uint), &ocl_boundary) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_collect_active, 4, sizeof(cl_int), &ocl_max_level) != CL_SUCCESS))
+	{
+		clReleaseEvent(ocl_event_reset);
+		release();
+		throw std::runtime_error("OpenCL cannot set kernel arguments.");
+	}
+
+	enqueue_kernel(m_ocl_kernel_collect_active, nullptr, 1, &ocl_event_reset, event);
+}
+
+
+void Ocl_backend::accelerate_active(cl_event wait_event, cl_event* event)
+{
+	enqueue_kernel(m_ocl_kernel_accelerate_active, &m_ocl_local_work_size, 1, &wait_event, event);
+}
+
+
+void Ocl_backend::kick_block(unsigned boundary, bool close, bool open, cl_event wait_event, cl_event* event)
+{
+	const cl_float ocl_time_step = m_settings.time_step;
+	const cl_int ocl_max_level = m_settings.block_levels;
+	const cl_uint ocl_boundary = boundary;
+	const cl_int ocl_close = close ? 1 : 0;
+	const cl_int ocl_open = open ? 1 : 0;
+	const cl_float ocl_accuracy = m_settings.block_accuracy;
+
+	if ((clSetKernelArg(m_ocl_kernel_kick_block, 5, sizeof(cl_float), &ocl_time_step) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 6, sizeof(cl_int), &ocl_max_level) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 7, sizeof(cl_uint), &ocl_boundary) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 8, sizeof(cl_int), &ocl_close) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 9, sizeof(cl_int), &ocl_open) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_kick_block, 10, sizeof(cl_float), &ocl_accuracy) != CL_SUCCESS))
+	{
+		clReleaseEvent(wait_event);
+		release();
+		throw std::runtime_error("OpenCL cannot set kernel arguments.");
+	}
+
+	enqueue_kernel(m_ocl_kernel_kick_block, nullptr, 1, &wait_event, event);
+}
+
+
+void Ocl_backend::step(cl_event wait_event, cl_event* event)
+{
+	const bool leapfrog = (m_settings.integrator != Settings::Integrator::EULER);
+	const float time_step = m_settings.time_step;
+	cl_event ocl_event_started = wait_event;
+
+	if (leapfrog)
+	{
+		if (!m_acc_valid)
+		{
+			cl_event ocl_event_initial;
+			accelerate(ocl_event_started, &ocl_event_initial);
+			ocl_event_started = ocl_event_initial;
+		}
+
+		cl_event ocl_event_half_kicked;
+		kick(0.5f * time_step, ocl_event_started, &ocl_event_half_kicked);
+		ocl_event_started = ocl_event_half_kicked;
+	}
+
+	cl_event ocl_event_drifted;
+	drift(time_step, ocl_event_started, &ocl_event_drifted);
+
+	cl_event ocl_event_accelerated;
+	accelerate(ocl_event_drifted, &ocl_event_accelerated);
+
+	kick(leapfrog ? (0.5f * time_step) : time_step, ocl_event_accelerated, event);
+}
+
+
+void Ocl_backend::step_block(cl_event wait_event, cl_event* event)
+{
+	const unsigned max_level = static_cast<unsigned>(m_settings.block_levels);
+	const unsigned num_substeps = 1u << max_level;
+	const float substep = m_settings.time_step / num_substeps;
+	cl_event ocl_event = wait_event;
+
+	if (!m_acc_valid)
+	{
+		cl_event ocl_event_initial;
+		accelerate(ocl_event, &ocl_event_initial);
+		ocl_event = ocl_event_initial;
+	}
+
+	cl_event ocl_event_collected;
+	collect_active(0, ocl_event, &ocl_event_collected);
+	kick_block(0, false, true, ocl_event_collected, &ocl_event);
+
+	for (unsigned s = 0; s < num_substeps; s++)
+	{
+		const unsigned boundary = s + 1;
+
+		cl_event ocl_event_drifted;
+		drift(substep, ocl_event, &ocl_event_drifted);
+
+		collect_active(boundary, ocl_event_drifted, &ocl_event_collected);
+
+		cl_event ocl_event_accelerated;
+		accelerate_active(ocl_event_collected, &ocl_event_accelerated);
+
+		kick_block(boundary, true, boundary < num_substeps, ocl_event_accelerated,
+			(boundary < num_substeps) ? &ocl_event : event);
+	}
+}
+
+
+void Ocl_backend::step_hermite(cl_event wait_event, cl_event* event)
+{
+	const cl_float ocl_time_step = m_settings.time_step;
+	cl_event ocl_event_started = wait_event;
+
+	if (!m_jerk_valid)
+	{
+		cl_event ocl_event_initial;
+		enqueue_kernel(m_ocl_kernel_accelerate_jerk, &m_ocl_local_work_size, 1, &ocl_event_started, &ocl_event_initial);
+		ocl_event_started = ocl_event_initial;
+	}
+
+	if ((clSetKernelArg(m_ocl_kernel_hermite_predict, 9, sizeof(cl_float), &ocl_time_step) != CL_SUCCESS) ||
+		(clSetKernelArg(m_ocl_kernel_hermite_correct, 9, sizeof(cl_float), &ocl_time_step) != CL_SUCCESS))
+	{
+		clReleaseEvent(ocl_event_started);
+		release();
+		throw std::runtime_error("OpenCL cannot set kernel arguments.");
+	}
+
+	cl_event ocl_event_predicted;
+	enqueue_kernel(m_ocl_kernel_hermite_predict, nullptr, 1, &ocl_event_started, &ocl_event_predicted);
+
+	cl_event ocl_event_accelerated;
+	enqueue_kernel(m_ocl_kernel_accelerate_jerk, &m_ocl_local_work_size, 1, &ocl_event_predicted, &ocl_event_accelerated);
+
+	enqueue_kernel(m_ocl_kernel_hermite_correct, nullptr, 1, &ocl_event_accelerated, event);
+	track_positions(*event);
+}
+
+
+void Ocl_backend::gather(cl_kernel kernel, cl_mem buffer, cl_mem scratch, size_t size, cl_event wait_event, cl_event* event)
+{
+	if ((clSetKernelArg(kernel, 0, sizeof(cl_mem), &scratch) != CL_SUCCESS) ||
+		(clSetKernelArg(kernel, 1, sizeof(cl_mem), &buffer) != CL_SUCCESS))
+	{
+		clReleaseEvent(wait_event);
+		release();
+		throw std::runtime_error("OpenCL cannot set kernel arguments.");
+	}
+
+	cl_event ocl_event_gathered;
+	enqueue_kernel(kernel, nullptr, 1, &wait_event, &ocl_event_gathered);
+
+	cl_int ocl_err = clEnqueueCopyBuffer(m_ocl_cmd_queue, scratch, buffer, 0, 0, m_num * size, 1, &ocl_event_gathered, event);
+	clReleaseEvent(ocl_event_gathered);
+	check(ocl_err, "OpenCL cannot copy buffer.");
+}
+
+
+void Ocl_backend::reorder(cl_event wait_event, cl_event* event)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	cl_event ocl_event_keyed;
+	enqueue_kernel(m_ocl_kernel_morton_keys, nullptr, 1, &wait_event, &ocl_event_keyed);
+
+	cl_int ocl_err = clEnqueueReadBuffer(m_ocl_cmd_queue, m_ocl_buffer_key, CL_TRUE, 0, m_num * sizeof(cl_uint),
+		m_key_host.get(), 1, &ocl_event_keyed, nullptr);
+
+	clReleaseEvent(ocl_event_keyed);
+	check(ocl_err, "OpenCL cannot read keys.");
+
+	Utils::radix_sort(m_key_host.get(), m_num, m_order_host.get());
+
+	// slot i receives the star of old slot order[i], and the host remembers which star that is
+	std::vector<cl_int> stars(m_num);
+
+	for (GLsizei i = 0; i < m_num; i++)
+		stars[i] = m_star_host[m_order_host[i]];
+
+	std::copy(stars.begin(), stars.end(), m_star_host.get());
+
+	cl_event ocl_event_ordered;
+	check(clEnqueueWriteBuffer(m_ocl_cmd_queue, m_ocl_buffer_order, CL_FALSE, 0, m_num * sizeof(cl_int),
+		m_order_host.get(), 0, nullptr, &ocl_event_ordered), "OpenCL cannot write order.");
+
+	// each gather touches its own buffers, so they only wait for the order
+	cl_event ocl_events_gathered[5];
+
+	for (int g = 0; g < 5; g++)
+		clRetainEvent(ocl_event_ordered);
+
+	gather(m_ocl_kernel_gather, m_ocl_buffer_pos, m_ocl_buffer_pos_old, m_vector_size, ocl_event_ordered, &ocl_events_gathered[0]);
+	gather(m_ocl_kernel_gather, m_ocl_buffer_vel, m_ocl_buffer_vel_old, m_vector_size, ocl_event_ordered, &ocl_events_gathered[1]);
+	gather(m_ocl_kernel_gather, m_ocl_buffer_acc, m_ocl_buffer_acc_old, m_vector_size, ocl_event_ordered, &ocl_events_gathered[2]);
+	gather(m_ocl_kernel_gather, m_ocl_buffer_jerk, m_ocl_buffer_jerk_old, m_vector_size, ocl_event_ordered, &ocl_events_gathered[3]);
+	gather(m_ocl_kernel_gather_int, m_ocl_buffer_level, m_ocl_buffer_active, sizeof(cl_int), ocl_event_ordered, &ocl_events_gathered[4]);
+	clReleaseEvent(ocl_event_ordered);
+
+	track_positions(ocl_events_gathered[0]);
+
+	cl_int ocl_err_joined = clEnqueueMarkerWithWaitList(m_ocl_cmd_queue, 5, ocl_events_gathered, event);
+
+	for (cl_event ocl_event_gathered : ocl_events_gathered)
+		clReleaseEvent(ocl_event_gathered);
+
+	check(ocl_err_joined, "OpenCL cannot enqueue marker.");
+	check(clWaitForEvents(1, event), "OpenCL cannot reorder stars.");
+
+	m_reorder_time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	m_reorder_count++;
+	m_steps_since_reorder = 0;
+}
+
+
+void Ocl_backend::publish(cl_mem buffer, cl_uint num_wait_events, const cl_event* wait_events, cl_event* event)
+{
+	if (clSetKernelArg(m_ocl_kernel_publish, 0, sizeof(cl_mem), &buffer) != CL_SUCCESS)
+	{
+		for (cl_uint i = 0; i < num_wait_events; i++)
+			clReleaseEvent(wait_events[i]);
+
+		release();
+		throw std::runtime_error("OpenCL cannot set kernel arguments.");
+	}
+
+	enqueue_kernel(m_ocl_kernel_publish, nullptr, num_wait_events, wait_events, event);
+}
+
+
+void Ocl_backend::step(const Settings& settings, unsigned steps)
+{
+	if (!same_forces(m_settings, settings))
+	{
+		m_acc_valid = false;
+		m_jerk_valid = false;
+	}
+
+	m_settings = settings;
+
+	if (!specialise(m_settings))
+	{
+		release();
+		throw std::runtime_error("OpenCL cannot build kernels.");
+	}
+
+	cl_event ocl_event_kicked;
+	begin_commands(&ocl_event_kicked);
+
+	// only the direct sum can evaluate the active stars alone or the jerk, so the other solvers step both as leapfrog
+	const bool block = (m_settings.integrator == Settings::Integrator::BLOCK) && (m_settings.solver == Settings::Solver::DIRECT);
+	const bool hermite = (m_settings.integrator == Settings::Integrator::HERMITE) && (m_settings.solver == Settings::Solver::DIRECT);
+
+	// the whole batch is chained on the queue and flushed once
+	for (unsigned s = 0; s < steps; s++)
+	{
+		if ((m_settings.reorder_interval > 0) && (m_steps_since_reorder >= static_cast<unsigned>(m_settings.reorder_interval)))
+			reorder(ocl_event_kicked, &ocl_event_kicked);
+
+		if (block)
+			step_block(ocl_event_kicked, &ocl_event_kicked);
+		else if (hermite)
+			step_hermite(ocl_event_kicked, &ocl_event_kicked);
+		else
+			step(ocl_event_kicked, &ocl_event_kicked);
+
+		m_acc_valid = true;
+		m_jerk_valid = hermite;
+		m_steps_since_reorder++;
+	}
+
+	end_commands(ocl_event_kicked);
+}
+
+
+void Ocl_backend::accelerations(const Settings& settings, Vector4D* acc)
+{
+	m_settings = settings;
+
+	if (!specialise(m_settings))
+	{
+		release();
+		throw std::runtime_error("OpenCL cannot build kernels.");
+	}
+
+	cl_event ocl_event_started;
+	begin_commands(&ocl_event_started);
+
+	cl_event ocl_event_accelerated;
+	accelerate(ocl_event_started, &ocl_event_accelerated);
+
+	read_vectors(m_ocl_buffer_acc, acc, ocl_event_accelerated, "OpenCL cannot read accelerations.");
+	end_commands(nullptr);
+	unpermute(acc);
+
+	m_acc_valid = true;
+	m_jerk_valid = false;
+}
+
+
+void Ocl_backend::map_positions(size_t slot)
+{
+	if (m_interop)
+	{
+		// only the publish waits for GL to finish drawing; the next step is already queued on the simulation buffers
+		cl_event ocl_events_ready[2];
+		acquire_render(slot, &ocl_events_ready[0]);
+		positions_written(&ocl_events_ready[1]);
+
+		cl_event ocl_event_published;
+		publish(m_ocl_buffers_render[slot], 2, ocl_events_ready, &ocl_event_published);
+
+		release_render(slot, ocl_event_published);
+		return;
+	}
+
+	const void* render = m_pos_host.get();
+
+	if (m_packing == Packing::FLOAT)
+	{
+		cl_event ocl_event_written;
+		positions_written(&ocl_event_written);
+
+		read_vectors(m_ocl_buffer_pos, m_pos_host.get(), ocl_event_written, "OpenCL cannot read positions.");
+	}
+	else
+	{
+		cl_event ocl_event_written;
+		positions_written(&ocl_event_written);
+
+		cl_event ocl_event_published;
+		publish(m_ocl_buffer_packed, 1, &ocl_event_written, &ocl_event_published);
+
+		check(clEnqueueReadBuffer(m_ocl_cmd_queue, m_ocl_buffer_packed, CL_TRUE, 0, m_num * packed_size(m_packing),
+			m_render_host.get(), 1, &ocl_event_published, nullptr), "OpenCL cannot read positions.");
+
+		clReleaseEvent(ocl_event_published);
+		render = m_render_host.get();
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbos[slot]);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_num * packed_size(m_packing), render);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void Ocl_backend::positions(Vector4D* pos)
+{
+	cl_event ocl_event_written;
+	positions_written(&ocl_event_written);
+
+	read_vectors(m_ocl_buffer_pos, pos, ocl_event_written, "OpenCL cannot read positions.");
+	end_commands(nullptr);
+
+	unpermute(pos);
+}
+
+
+void Ocl_backend::state(Vector4D* pos, Vector4D* vel)
+{
+	cl_event ocl_event_started;
+	begin_commands(&ocl_event_started);
+
+	clRetainEvent(ocl_event_started);
+	read_vectors(m_ocl_buffer_pos, pos, ocl_event_started, "OpenCL cannot read positions.");
+	read_vectors(m_ocl_buffer_vel, vel, ocl_event_started, "OpenCL cannot read velocities.");
+	end_commands(nullptr);
+
+	unpermute(pos);
+	unpermute(vel);
+}
+
+
+Backend::Kind Ocl_backend::kind() const
+{
+	return m_cpu ? Kind::OPENCL_CPU : Kind::OPENCL_GPU;
+}
+
+
+void Ocl_backend::finish()
+{
+	check(clFinish(m_ocl_cmd_queue), "OpenCL cannot finish.");
+}
+
+
+bool Ocl_backend::shares_gl() const
+{
+	return m_interop;
+}
+
+
+unsigned Ocl_backend::get_reorder_count() const
+{
+	return m_reorder_count;
+}
+
+
+double Ocl_backend::get_reorder_time() const
+{
+	return m_reorder_time;
+}
+
+
+void Ocl_backend::tune(const Settings& settings, std::ostream& out)
+{
+	const unsigned repeats = 5;
+	const size_t local_sizes[] = { 32, 64, 128, 256 };
+	const int unrolls[] = { 1, 2, 4, 8 };
+
+	if (m_ocl_cmd_queue == nullptr) throw std::runtime_error("Not initialised.");
+
+	m_settings = settings;
+
+	cl_ulong ocl_local_mem_size = 0;
+	check(clGetDeviceInfo(m_ocl_device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &ocl_local_mem_size, nullptr),
+		"OpenCL cannot query device.");
+
+	out << "Force kernel tuning on " << ocl_device_string(m_ocl_device, CL_DEVICE_NAME) << ", " << m_num << " stars" << std::endl;
+	out << std::setw(12) << "local size" << std::setw(8) << "unroll" << std::setw(14) << "time [ms]" << std::endl;
+
+	size_t best_local_size = 0;
+	int best_unroll = 1;
+	double best_time = std::numeric_limits<double>::max();
+
+	for (const int unroll : unrolls)
+	{
+		for (const size_t local_size : local_sizes)
+		{
+			// accelerate_jerk holds two tiles, so every candidate has to fit both in local memory
+			if (2 * local_size * m_vector_size > ocl_local_mem_size) continue;
+
+			m_ocl_tuned_local_size = local_size;
+			m_ocl_unroll = unroll;
+			m_ocl_options.clear();
+
+			if (!specialise(m_settings) || (m_ocl_local_work_size != local_size)) continue;
+
+			const double time = time_force_kernel(repeats);
+			out << std::setw(12) << local_size << std::setw(8) << unroll << std::setw(14) << std::fixed << std::setprecision(3) << time << std::endl;
+
+			if (time < best_time)
+			{
+				best_time = time;
+				best_local_size = local_size;
+				best_unroll = unroll;
+			}
+		}
+	}
+
+	m_ocl_tuned_local_size = best_local_size;
+	m_ocl_unroll = best_unroll;
+	m_ocl_options.clear();
+
+	if (!specialise(m_settings))
+	{
+		release();
+		throw std::runtime_error("OpenCL cannot build kernels.");
+	}
+
+	if (best_local_size != 0)
+	{
+		store_tuning();
+		out << "best: local size " << best_local_size << ", unroll " << best_unroll << " -> " << tuning_file() << std::endl;
+	}
+}
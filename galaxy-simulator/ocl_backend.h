@@ -0,0 +1,173 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef OCL_BACKEND_H
+#define OCL_BACKEND_H
+
+#include <CL/opencl.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "backend.h"
+#include "host_solvers.h"
+
+class Ocl_backend : public Backend
+{
+private:
+	struct Programs
+	{
+		cl_program main;
+		cl_program strict;
+	};
+
+	typedef cl_event(CL_API_CALL* Create_event_from_gl_sync)(cl_context context, cl_GLsync sync, cl_int* errcode_ret);
+
+	const GLsizei m_num;
+	const bool m_cpu;
+	const Precision m_precision;
+	const size_t m_vector_size;
+	const Packing m_packing;
+
+	bool m_interop;
+	std::thread::id m_gl_thread;
+	bool m_acc_valid;
+	bool m_jerk_valid;
+	std::unique_ptr<Vector4D[]> m_pos_host;
+	std::unique_ptr<Vector4D[]> m_acc_host;
+	std::unique_ptr<cl_uint[]> m_key_host;
+	std::unique_ptr<cl_int[]> m_order_host;
+	std::unique_ptr<cl_int[]> m_star_host;
+	std::unique_ptr<Vector4D[]> m_slot_host;
+	std::unique_ptr<cl_double4[]> m_stage_host;
+	std::unique_ptr<cl_uchar[]> m_render_host;
+	unsigned m_steps_since_reorder;
+	unsigned m_reorder_count;
+	double m_reorder_time;
+	Settings m_settings;
+	Host_solvers m_solvers;
+	cl_context m_ocl_context;
+	cl_device_id m_ocl_device;
+	cl_command_queue m_ocl_cmd_queue;
+	Create_event_from_gl_sync m_ocl_create_event_from_gl_sync;
+	GLsync m_gl_sync_rendered;
+	cl_event m_ocl_event_positions;
+	std::map<std::string, Programs> m_ocl_programs;
+	std::string m_ocl_options;
+	cl_kernel m_ocl_kernel_drift;
+	cl_kernel m_ocl_kernel_accelerate;
+	cl_kernel m_ocl_kernel_accelerate_kahan;
+	cl_kernel m_ocl_kernel_accelerate_double;
+	cl_kernel m_ocl_kernel_kick;
+	cl_kernel m_ocl_kernel_accelerate_tree;
+	cl_kernel m_ocl_kernel_collect_active;
+	cl_kernel m_ocl_kernel_accelerate_active;
+	cl_kernel m_ocl_kernel_kick_block;
+	cl_kernel m_ocl_kernel_accelerate_jerk;
+	cl_kernel m_ocl_kernel_hermite_predict;
+	cl_kernel m_ocl_kernel_hermite_correct;
+	cl_kernel m_ocl_kernel_morton_keys;
+	cl_kernel m_ocl_kernel_gather;
+	cl_kernel m_ocl_kernel_gather_int;
+	cl_kernel m_ocl_kernel_publish;
+	size_t m_ocl_local_work_size;
+	size_t m_ocl_tuned_local_size;
+	int m_ocl_unroll;
+	std::vector<GLuint> m_vbos;
+	std::vector<cl_mem> m_ocl_buffers_render;
+	cl_mem m_ocl_buffer_packed;
+	cl_mem m_ocl_buffer_pos;
+	cl_mem m_ocl_buffer_vel;
+	cl_mem m_ocl_buffer_jerk;
+	cl_mem m_ocl_buffer_pos_old;
+	cl_mem m_ocl_buffer_vel_old;
+	cl_mem m_ocl_buffer_acc_old;
+	cl_mem m_ocl_buffer_jerk_old;
+	cl_mem m_ocl_buffer_acc;
+	size_t m_ocl_tree_capacity;
+	cl_mem m_ocl_buffer_node_com;
+	cl_mem m_ocl_buffer_node_quad_diag;
+	cl_mem m_ocl_buffer_node_quad_offdiag;
+	cl_mem m_ocl_buffer_node_link;
+	cl_mem m_ocl_buffer_body;
+	cl_mem m_ocl_buffer_level;
+	cl_mem m_ocl_buffer_active;
+	cl_mem m_ocl_buffer_num_active;
+	cl_mem m_ocl_buffer_key;
+	cl_mem m_ocl_buffer_order;
+
+	std::string build_options(const Settings& settings) const;
+	bool specialise(const Settings& settings);
+	void release_kernels();
+	std::string binary_key(cl_device_id ocl_device, const char* options) const;
+	cl_program load_binary(cl_device_id ocl_device, const std::string& key);
+	void store_binary(cl_program ocl_program, const std::string& key) const;
+	std::string tuning_file() const;
+	void load_tuning();
+	void store_tuning() const;
+	double time_force_kernel(unsigned repeats);
+	cl_program build_program(cl_device_id ocl_device, const char* options, const std::string& log_name);
+	cl_kernel accumulating_kernel() const;
+	void enqueue_kernel(cl_kernel kernel, const size_t* local_work_size,
+		cl_uint num_wait_events, const cl_event* wait_events, cl_event* event);
+	void check(cl_int ocl_err, const char* message);
+	void begin_commands(cl_event* event);
+	void end_commands(cl_event wait_event);
+	void track_positions(cl_event event);
+	void positions_written(cl_event* event);
+	void acquire_render(size_t slot, cl_event* event);
+	void release_render(size_t slot, cl_event wait_event);
+	void release_tree_buffers();
+	void reserve_tree_buffers(size_t num_nodes);
+	const void* stage_vectors(const Vector4D* src);
+	void read_vectors(cl_mem buffer, Vector4D* dst, cl_event wait_event, const char* message);
+	void write_vectors(cl_mem buffer, const Vector4D* src, cl_event* event, const char* message);
+	void read_positions(cl_event wait_event);
+	void unpermute(Vector4D* data);
+	void accelerate(cl_event wait_event, cl_event* event);
+	void accelerate_host(cl_event wait_event, cl_event* event);
+	void accelerate_tree(cl_event wait_event, cl_event* event);
+	void drift(float time_step, cl_event wait_event, cl_event* event);
+	void kick(float time_step, cl_event wait_event, cl_event* event);
+	void collect_active(unsigned boundary, cl_event wait_event, cl_event* event);
+	void accelerate_active(cl_event wait_event, cl_event* event);
+	void kick_block(unsigned boundary, bool close, bool open, cl_event wait_event, cl_event* event);
+	void step(cl_event wait_event, cl_event* event);
+	void step_block(cl_event wait_event, cl_event* event);
+	void step_hermite(cl_event wait_event, cl_event* event);
+	void gather(cl_kernel kernel, cl_mem buffer, cl_mem scratch, size_t size, cl_event wait_event, cl_event* event);
+	void reorder(cl_event wait_event, cl_event* event);
+	void publish(cl_mem buffer, cl_uint num_wait_events, const cl_event* wait_events, cl_event* event);
+
+public:
+	Ocl_backend(GLsizei num, bool cpu, Precision precision, Packing packing);
+	~Ocl_backend();
+
+	bool init(const Settings& settings, const GLuint* vbos, size_t num_vbos, const Vector4D* pos, const Vector4D* vel) override;
+	void step(const Settings& settings, unsigned steps) override;
+	void accelerations(const Settings& settings, Vector4D* acc) override;
+	void map_positions(size_t slot) override;
+	void positions(Vector4D* pos) override;
+	void state(Vector4D* pos, Vector4D* vel) override;
+	void release() override;
+	Kind kind() const override;
+	void finish() override;
+	bool shares_gl() const override;
+	unsigned get_reorder_count() const override;
+	double get_reorder_time() const override;
+	void tune(const Settings& settings, std::ostream& out) override;
+};
+
+#endif
@@ -0,0 +1,377 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "octree.h"
+#include "gravity.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+
+
+void Octree::build(const Bodies& bodies, size_t num, float mass)
+{
+	m_com.clear();
+	m_quad_diag.clear();
+	m_quad_offdiag.clear();
+	m_link.clear();
+	m_body.resize(num);
+	m_body_temp.resize(num);
+
+	if (num == 0) return;
+
+	const Vector4D first = bodies.position(0);
+	float min_x = first.x, max_x = first.x;
+	float min_y = first.y, max_y = first.y;
+	float min_z = first.z, max_z = first.z;
+
+	for (size_t i = 0; i < num; i++)
+	{
+		const Vector4D pos = bodies.position(i);
+		m_body[i] = static_cast<std::int32_t>(i);
+
+		min_x = std::min(min_x, pos.x);
+		max_x = std::max(max_x, pos.x);
+		min_y = std::min(min_y, pos.y);
+		max_y = std::max(max_y, pos.y);
+		min_z = std::min(min_z, pos.z);
+		max_z = std::max(max_z, pos.z);
+	}
+
+	float half = 0.5f * std::max(max_x - min_x, std::max(max_y - min_y, max_z - min_z));
+	if (half <= 0.0f) half = 1.0f;
+
+	build_node(bodies, 0, num, 0.5f * (min_x + max_x), 0.5f * (min_y + max_y), 0.5f * (min_z + max_z), half, 0, mass);
+
+	const auto num_nodes = static_cast<std::int32_t>(m_link.size());
+
+	for (auto& link : m_link)
+	{
+		if (link.next >= num_nodes) link.next = -1;
+	}
+}
+
+
+std::int32_t Octree::build_node(const Bodies& bodies, size_t first, size_t count,
+	float cx, float cy, float cz, float half, unsigned depth, float mass)
+{
+	const auto index = static_cast<std::int32_t>(m_link.size());
+
+	m_com.push_back({ 0.0f, 0.0f, 0.0f, 0.0f });
+	m_quad_diag.push_back({ 0.0f, 0.0f, 0.0f, 2.0f * half });
+	m_quad_offdiag.push_back({ 0.0f, 0.0f, 0.0f, 0.0f });
+	m_link.push_back({ -1, static_cast<std::int32_t>(first), static_cast<std::int32_t>(count), 0 });
+
+	Vector4D com = { 0.0f, 0.0f, 0.0f, count * mass };
+	Vector4D quad_diag = { 0.0f, 0.0f, 0.0f, 2.0f * half };
+	Vector4D quad_offdiag = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	if ((count <= m_leaf_size) || (depth >= m_max_depth))
+	{
+		for (size_t k = first; k < first + count; k++)
+		{
+			const Vector4D pos = bodies.position(m_body[k]);
+			com.x += pos.x;
+			com.y += pos.y;
+			com.z += pos.z;
+		}
+
+		com.x /= count;
+		com.y /= count;
+		com.z /= count;
+
+		for (size_t k = first; k < first + count; k++)
+		{
+			const Vector4D pos = bodies.position(m_body[k]);
+			const float dx = pos.x - com.x;
+			const float dy = pos.y - com.y;
+			const float dz = pos.z - com.z;
+			const float d2 = dx * dx + dy * dy + dz * dz;
+
+			quad_diag.x += mass * (3.0f * dx * dx - d2);
+			quad_diag.y += mass * (3.0f * dy * dy - d2);
+			quad_diag.z += mass * (3.0f * dz * dz - d2);
+			quad_offdiag.x += mass * 3.0f * dx * dy;
+			quad_offdiag.y += mass * 3.0f * dx * dz;
+			quad_offdiag.z += mass * 3.0f * dy * dz;
+		}
+
+		m_link[index].leaf = 1;
+	}
+	else
+	{
+		size_t octant_count[8] = { 0 };
+		size_t octant_offset[8];
+
+		auto octant = [&](const Vector4D& p)
+		{
+			return ((p.x > cx) ? 1 : 0) | ((p.y > cy) ? 2 : 0) | ((p.z > cz) ? 4 : 0);
+		};
+
+		for (size_t k = first; k < first + count; k++)
+		{
+			octant_count[octant(bodies.position(m_body[k]))]++;
+		}
+
+		octant_offset[0] = first;
+		for (int o = 1; o < 8; o++)
+		{
+			octant_offset[o] = octant_offset[o - 1] + octant_count[o - 1];
+		}
+
+		for (size_t k = first; k < first + count; k++)
+		{
+			m_body_temp[octant_offset[octant(bodies.position(m_body[k]))]++] = m_body[k];
+		}
+
+		std::copy(m_body_temp.begin() + first, m_body_temp.begin() + first + count, m_body.begin() + first);
+
+		std::int32_t children[8];
+		int num_children = 0;
+		size_t child_first = first;
+		const float child_half = 0.5f * half;
+
+		for (int o = 0; o < 8; o++)
+		{
+			if (octant_count[o] == 0) continue;
+
+			children[num_children++] = build_node(bodies, child_first, octant_count[o],
+				cx + ((o & 1) ? child_half : -child_half),
+				cy + ((o & 2) ? child_half : -child_half),
+				cz + ((o & 4) ? child_half : -child_half),
+				child_half, depth + 1, mass);
+
+			child_first += octant_count[o];
+		}
+
+		for (int c = 0; c < num_children; c++)
+		{
+			const Vector4D& child_com = m_com[children[c]];
+			com.x += child_com.w * child_com.x;
+			com.y += child_com.w * child_com.y;
+			com.z += child_com.w * child_com.z;
+		}
+
+		com.x /= com.w;
+		com.y /= com.w;
+		com.z /= com.w;
+
+		for (int c = 0; c < num_children; c++)
+		{
+			const Vector4D& child_com = m_com[children[c]];
+			const Vector4D& child_quad_diag = m_quad_diag[children[c]];
+			const Vector4D& child_quad_offdiag = m_quad_offdiag[children[c]];
+
+			const float sx = child_com.x - com.x;
+			const float sy = child_com.y - com.y;
+			const float sz = child_com.z - com.z;
+			const float s2 = sx * sx + sy * sy + sz * sz;
+
+			quad_diag.x += child_quad_diag.x + child_com.w * (3.0f * sx * sx - s2);
+			quad_diag.y += child_quad_diag.y + child_com.w * (3.0f * sy * sy - s2);
+			quad_diag.z += child_quad_diag.z + child_com.w * (3.0f * sz * sz - s2);
+			quad_offdiag.x += child_quad_offdiag.x + child_com.w * 3.0f * sx * sy;
+			quad_offdiag.y += child_quad_offdiag.y + child_com.w * 3.0f * sx * sz;
+			quad_offdiag.z += child_quad_offdiag.z + child_com.w * 3.0f * sy * sz;
+		}
+	}
+
+	m_com[index] = com;
+	m_quad_diag[index] = quad_diag;
+	m_quad_offdiag[index] = quad_offdiag;
+	m_link[index].next = static_cast<std::int32_t>(m_link.size());
+
+	return index;
+}
+
+
+Vector4D Octree::walk(const Bodies& bodies, const Vector4D& pos_i, const Settings& settings) const
+{
+	Vector4D acc = { 0.0f, 0.0f, 0.0f, 0.0f };
+	std::int32_t node = m_link.empty() ? -1 : 0;
+
+	while (node >= 0)
+	{
+		const Link& link = m_link[node];
+
+		if (link.leaf)
+		{
+			for (std::int32_t k = link.body_first; k < link.body_first + link.body_count; k++)
+			{
+				Gravity::interaction(pos_i, bodies.position(m_body[k]), settings, acc);
+			}
+
+			node = link.next;
+			continue;
+		}
+
+		const Vector4D& com = m_com[node];
+		const Vector4D& quad_diag = m_quad_diag[node];
+
+		const float dx = com.x - pos_i.x;
+		const float dy = com.y - pos_i.y;
+		const float dz = com.z - pos_i.z;
+		const float r = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+		if ((quad_diag.w < settings.opening_angle * r) && (r > settings.radius + quad_diag.w))
+		{
+			const float inv_r = 1.0f / r;
+			const float inv_r3 = inv_r * inv_r * inv_r;
+
+			acc.x += com.w * inv_r3 * dx;
+			acc.y += com.w * inv_r3 * dy;
+			acc.z += com.w * inv_r3 * dz;
+
+			if (settings.quadrupole)
+			{
+				const Vector4D& quad_offdiag = m_quad_offdiag[node];
+
+				const float qx = quad_diag.x * dx + quad_offdiag.x * dy + quad_offdiag.y * dz;
+				const float qy = quad_offdiag.x * dx + quad_diag.y * dy + quad_offdiag.z * dz;
+				const float qz = quad_offdiag.y * dx + quad_offdiag.z * dy + quad_diag.z * dz;
+
+				const float inv_r5 = inv_r3 * inv_r * inv_r;
+				const float radial = 2.5f * (dx * qx + dy * qy + dz * qz) * inv_r5 * inv_r * inv_r;
+
+				acc.x += radial * dx - inv_r5 * qx;
+				acc.y += radial * dy - inv_r5 * qy;
+				acc.z += radial * dz - inv_r5 * qz;
+			}
+
+			node = link.next;
+		}
+		else
+		{
+			node++;
+		}
+	}
+
+	return acc;
+}
+
+
+Vector4D Octree::walk_short_range(const Bodies& bodies, const Vector4D& pos_i, const Settings& settings, float split, float cutoff) const
+{
+	Vector4D acc = { 0.0f, 0.0f, 0.0f, 0.0f };
+	std::int32_t node = m_link.empty() ? -1 : 0;
+
+	while (node >= 0)
+	{
+		const Link& link = m_link[node];
+		const Vector4D& com = m_com[node];
+		const float size = m_quad_diag[node].w;
+
+		const float dx = com.x - pos_i.x;
+		const float dy = com.y - pos_i.y;
+		const float dz = com.z - pos_i.z;
+		const float r = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+		// every body of the cell lies within one cube diagonal of its centre of mass
+		if (r > cutoff + 1.7320508f * size)
+		{
+			node = link.next;
+			continue;
+		}
+
+		if (link.leaf)
+		{
+			for (std::int32_t k = link.body_first; k < link.body_first + link.body_count; k++)
+			{
+				Gravity::short_range_interaction(pos_i, bodies.position(m_body[k]), settings, split, acc);
+			}
+
+			node = link.next;
+			continue;
+		}
+
+		if ((size < settings.opening_angle * r) && (r > settings.radius + size))
+		{
+			const float coef = com.w * Gravity::short_range_factor(r, split) / r / r / r;
+
+			acc.x += coef * dx;
+			acc.y += coef * dy;
+			acc.z += coef * dz;
+
+			node = link.next;
+		}
+		else
+		{
+			node++;
+		}
+	}
+
+	return acc;
+}
+
+
+void Octree::accelerations(const Bodies& bodies, const Settings& settings) const
+{
+	Utils::parallel_for(m_body.size(), 64, [&](size_t begin, size_t end)
+	{
+		for (size_t k = begin; k < end; k++)
+		{
+			const std::int32_t i = m_body[k];
+			bodies.set_acceleration(i, walk(bodies, bodies.position(i), settings));
+		}
+	});
+}
+
+
+void Octree::add_short_range(const Bodies& bodies, const Settings& settings, float split, float cutoff) const
+{
+	Utils::parallel_for(m_body.size(), 64, [&](size_t begin, size_t end)
+	{
+		for (size_t k = begin; k < end; k++)
+		{
+			const std::int32_t i = m_body[k];
+			bodies.add_acceleration(i, walk_short_range(bodies, bodies.position(i), settings, split, cutoff));
+		}
+	});
+}
+
+
+size_t Octree::num_nodes() const
+{
+	return m_link.size();
+}
+
+
+const Vector4D* Octree::com() const
+{
+	return m_com.data();
+}
+
+
+const Vector4D* Octree::quad_diag() const
+{
+	return m_quad_diag.data();
+}
+
+
+const Vector4D* Octree::quad_offdiag() const
+{
+	return m_quad_offdiag.data();
+}
+
+
+const Octree::Link* Octree::link() const
+{
+	return m_link.data();
+}
+
+
+const std::int32_t* Octree::body() const
+{
+	return m_body.data();
+}
@@ -0,0 +1,65 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include "bodies.h"
+#include "settings.h"
+#include "vector4d.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Octree
+{
+public:
+	struct Link
+	{
+		std::int32_t next;
+		std::int32_t body_first;
+		std::int32_t body_count;
+		std::int32_t leaf;
+	};
+
+private:
+	static const size_t m_leaf_size = 8;
+	static const unsigned m_max_depth = 24;
+
+	std::vector<Vector4D> m_com;
+	std::vector<Vector4D> m_quad_diag;
+	std::vector<Vector4D> m_quad_offdiag;
+	std::vector<Link> m_link;
+	std::vector<std::int32_t> m_body;
+	std::vector<std::int32_t> m_body_temp;
+
+	std::int32_t build_node(const Bodies& bodies, size_t first, size_t count,
+		float cx, float cy, float cz, float half, unsigned depth, float mass);
+	Vector4D walk(const Bodies& bodies, const Vector4D& pos_i, const Settings& settings) const;
+	Vector4D walk_short_range(const Bodies& bodies, const Vector4D& pos_i, const Settings& settings, float split, float cutoff) const;
+
+public:
+	void build(const Bodies& bodies, size_t num, float mass);
+	void accelerations(const Bodies& bodies, const Settings& settings) const;
+	void add_short_range(const Bodies& bodies, const Settings& settings, float split, float cutoff) const;
+
+	size_t num_nodes() const;
+	const Vector4D* com() const;
+	const Vector4D* quad_diag() const;
+	const Vector4D* quad_offdiag() const;
+	const Link* link() const;
+	const std::int32_t* body() const;
+};
+
+#endif
@@ -0,0 +1,29 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPENGL_H
+#define OPENGL_H
+
+#ifdef HEADLESS
+// builds without a display keep the GL types the interfaces use, but none of the calls
+typedef int GLsizei;
+typedef unsigned int GLuint;
+typedef float GLfloat;
+typedef unsigned long GLulong;
+#else
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+#endif
+
+#endif
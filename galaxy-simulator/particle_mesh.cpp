@@ -0,0 +1,293 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "particle_mesh.h"
+#include "utils.h"
+#include <algorithm>
+#include <cmath>
+#include <new>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+Particle_mesh::Particle_mesh() :
+	m_grid(0),
+	m_cell(1.0f),
+	m_origin(0.0f),
+	m_green_mass(0.0f),
+	m_green_split(-1.0f)
+{
+}
+
+
+void Particle_mesh::prepare(size_t grid, float mass, float split)
+{
+	if ((grid == m_grid) && (mass == m_green_mass) && (split == m_green_split)) return;
+
+	if (grid != m_grid)
+	{
+		// a grid that does not fit in memory keeps the previous one instead of aborting the run
+		try
+		{
+			const size_t padded = 2 * grid;
+			std::vector<std::complex<float>> green(padded * padded * padded);
+			std::vector<std::complex<float>> density(padded * padded * padded);
+			std::vector<float> field[3];
+
+			for (auto& component : field)
+			{
+				component.resize(grid * grid * grid);
+			}
+
+			m_green.swap(green);
+			m_density.swap(density);
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				m_field[axis].swap(field[axis]);
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			if (m_grid == 0) throw;
+
+			grid = m_grid;
+			if ((mass == m_green_mass) && (split == m_green_split)) return;
+		}
+	}
+
+	m_grid = grid;
+	m_green_mass = mass;
+	m_green_split = split;
+	m_cell = 2.0f / static_cast<float>(grid - 4);
+	m_origin = -1.0f - 2.0f * m_cell;
+
+	const size_t padded = 2 * grid;
+
+	Utils::parallel_for(padded, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t k = begin; k < end; k++)
+		{
+			const double dz = static_cast<double>((k <= grid) ? k : (padded - k)) * static_cast<double>(m_cell);
+
+			for (size_t j = 0; j < padded; j++)
+			{
+				const double dy = static_cast<double>((j <= grid) ? j : (padded - j)) * static_cast<double>(m_cell);
+
+				for (size_t i = 0; i < padded; i++)
+				{
+					const double dx = static_cast<double>((i <= grid) ? i : (padded - i)) * static_cast<double>(m_cell);
+					const double r = std::sqrt(dx * dx + dy * dy + dz * dz);
+					double green;
+
+					if (split > 0.0f)
+						green = (r > 0.0) ? (-mass * std::erf(r / (2.0 * split)) / r) : (-mass / (split * std::sqrt(M_PI)));
+					else
+						green = -mass / std::sqrt(r * r + 0.25 * m_cell * m_cell);
+
+					m_green[(k * padded + j) * padded + i] = static_cast<float>(green);
+				}
+			}
+		}
+	});
+
+	m_fft.transform(m_green.data(), padded, false);
+}
+
+
+void Particle_mesh::deposit(const Bodies& bodies, size_t num)
+{
+	const size_t grid = m_grid;
+	const size_t padded = 2 * grid;
+	const float limit = static_cast<float>(grid) - 1.001f;
+
+	auto cell = [&](float x, size_t& index, float& frac)
+	{
+		const float u = std::min(std::max((x - m_origin) / m_cell - 0.5f, 0.0f), limit);
+		index = static_cast<size_t>(u);
+		frac = u - static_cast<float>(index);
+	};
+
+	std::fill(m_density.begin(), m_density.end(), 0.0f);
+
+	m_slab_first.assign(grid + 1, 0);
+	m_slab_body.resize(num);
+
+	for (size_t b = 0; b < num; b++)
+	{
+		size_t k;
+		float fz;
+		cell(bodies.position(b).z, k, fz);
+		m_slab_first[k + 1]++;
+	}
+
+	for (size_t s = 0; s < grid; s++)
+	{
+		m_slab_first[s + 1] += m_slab_first[s];
+	}
+
+	std::vector<size_t> slab_next(m_slab_first.begin(), m_slab_first.end() - 1);
+
+	for (size_t b = 0; b < num; b++)
+	{
+		size_t k;
+		float fz;
+		cell(bodies.position(b).z, k, fz);
+		m_slab_body[slab_next[k]++] = static_cast<std::int32_t>(b);
+	}
+
+	for (size_t parity = 0; parity < 2; parity++)
+	{
+		Utils::parallel_for((grid - parity + 1) / 2, 1, [&](size_t begin, size_t end)
+		{
+			for (size_t s = 2 * begin + parity; s < 2 * end + parity; s += 2)
+			{
+				for (size_t n = m_slab_first[s]; n < m_slab_first[s + 1]; n++)
+				{
+					const Vector4D p = bodies.position(m_slab_body[n]);
+					size_t i, j, k;
+					float fx, fy, fz;
+
+					cell(p.x, i, fx);
+					cell(p.y, j, fy);
+					cell(p.z, k, fz);
+
+					for (size_t c = 0; c < 8; c++)
+					{
+						const size_t di = c & 1, dj = (c >> 1) & 1, dk = (c >> 2) & 1;
+						const float weight = (di ? fx : 1.0f - fx) * (dj ? fy : 1.0f - fy) * (dk ? fz : 1.0f - fz);
+
+						m_density[((k + dk) * padded + (j + dj)) * padded + (i + di)] += weight;
+					}
+				}
+			}
+		});
+	}
+}
+
+
+void Particle_mesh::solve()
+{
+	const size_t grid = m_grid;
+	const size_t padded = 2 * grid;
+
+	m_fft.transform(m_density.data(), padded, false);
+
+	Utils::parallel_for(m_density.size(), 4096, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			m_density[i] *= m_green[i];
+		}
+	});
+
+	m_fft.transform(m_density.data(), padded, true);
+
+	const float scale = 1.0f / static_cast<float>(padded * padded * padded);
+	const float inv_2h = 0.5f / m_cell;
+
+	auto potential = [&](size_t i, size_t j, size_t k)
+	{
+		return scale * m_density[(k * padded + j) * padded + i].real();
+	};
+
+	Utils::parallel_for(grid, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t k = begin; k < end; k++)
+		{
+			const size_t k0 = (k > 0) ? (k - 1) : k, k1 = (k + 1 < grid) ? (k + 1) : k;
+
+			for (size_t j = 0; j < grid; j++)
+			{
+				const size_t j0 = (j > 0) ? (j - 1) : j, j1 = (j + 1 < grid) ? (j + 1) : j;
+
+				for (size_t i = 0; i < grid; i++)
+				{
+					const size_t i0 = (i > 0) ? (i - 1) : i, i1 = (i + 1 < grid) ? (i + 1) : i;
+					const size_t index = (k * grid + j) * grid + i;
+
+					m_field[0][index] = -(potential(i1, j, k) - potential(i0, j, k)) * inv_2h * 2.0f / static_cast<float>(i1 - i0);
+					m_field[1][index] = -(potential(i, j1, k) - potential(i, j0, k)) * inv_2h * 2.0f / static_cast<float>(j1 - j0);
+					m_field[2][index] = -(potential(i, j, k1) - potential(i, j, k0)) * inv_2h * 2.0f / static_cast<float>(k1 - k0);
+				}
+			}
+		}
+	});
+}
+
+
+void Particle_mesh::interpolate(const Bodies& bodies, size_t num) const
+{
+	const size_t grid = m_grid;
+	const float limit = static_cast<float>(grid) - 1.001f;
+
+	Utils::parallel_for(num, 256, [&](size_t begin, size_t end)
+	{
+		for (size_t b = begin; b < end; b++)
+		{
+			const Vector4D pos = bodies.position(b);
+			float u[3] = { pos.x, pos.y, pos.z };
+			size_t index[3];
+			float frac[3];
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				u[axis] = std::min(std::max((u[axis] - m_origin) / m_cell - 0.5f, 0.0f), limit);
+				index[axis] = static_cast<size_t>(u[axis]);
+				frac[axis] = u[axis] - static_cast<float>(index[axis]);
+			}
+
+			float a[3] = { 0.0f, 0.0f, 0.0f };
+
+			for (size_t c = 0; c < 8; c++)
+			{
+				const size_t di = c & 1, dj = (c >> 1) & 1, dk = (c >> 2) & 1;
+				const float weight = (di ? frac[0] : 1.0f - frac[0]) * (dj ? frac[1] : 1.0f - frac[1]) * (dk ? frac[2] : 1.0f - frac[2]);
+				const size_t cell = ((index[2] + dk) * grid + (index[1] + dj)) * grid + (index[0] + di);
+
+				a[0] += weight * m_field[0][cell];
+				a[1] += weight * m_field[1][cell];
+				a[2] += weight * m_field[2][cell];
+			}
+
+			bodies.set_acceleration(b, { a[0], a[1], a[2], 0.0f });
+		}
+	});
+}
+
+
+size_t Particle_mesh::grid_size(const Settings& settings)
+{
+	size_t grid = 16;
+	while ((grid < static_cast<size_t>(std::max(settings.pm_grid, 16))) && (grid < max_grid)) grid <<= 1;
+	return grid;
+}
+
+
+float Particle_mesh::cell_size(const Settings& settings)
+{
+	return 2.0f / static_cast<float>(grid_size(settings) - 4);
+}
+
+
+void Particle_mesh::accelerations(const Bodies& bodies, size_t num, const Settings& settings, float split)
+{
+	prepare(grid_size(settings), settings.mass, split);
+	deposit(bodies, num);
+	solve();
+	interpolate(bodies, num);
+}
@@ -0,0 +1,56 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARTICLE_MESH_H
+#define PARTICLE_MESH_H
+
+#include "bodies.h"
+#include "fft.h"
+#include "settings.h"
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Particle_mesh
+{
+private:
+	size_t m_grid;
+	float m_cell;
+	float m_origin;
+	float m_green_mass;
+	float m_green_split;
+	Fft m_fft;
+	std::vector<std::complex<float>> m_green;
+	std::vector<std::complex<float>> m_density;
+	std::vector<float> m_field[3];
+	std::vector<std::int32_t> m_slab_body;
+	std::vector<size_t> m_slab_first;
+
+	void prepare(size_t grid, float mass, float split);
+	void deposit(const Bodies& bodies, size_t num);
+	void solve();
+	void interpolate(const Bodies& bodies, size_t num) const;
+
+public:
+	// the padded Green's function and density take 8 * (2 * grid)^3 bytes each
+	static constexpr size_t max_grid = (sizeof(void*) >= 8) ? 256 : 128;
+
+	Particle_mesh();
+	static size_t grid_size(const Settings& settings);
+	static float cell_size(const Settings& settings);
+	void accelerations(const Bodies& bodies, size_t num, const Settings& settings, float split = 0.0f);
+};
+
+#endif
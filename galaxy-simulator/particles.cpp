@@ -0,0 +1,206 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "particles.h"
+#include <algorithm>
+#include <new>
+#include <xmmintrin.h>
+
+
+void Particles::Free::operator()(float* data) const
+{
+	_mm_free(data);
+}
+
+
+Particles::Array Particles::allocate() const
+{
+	float* data = static_cast<float*>(_mm_malloc(m_capacity * sizeof(float), alignment));
+	if (data == nullptr) throw std::bad_alloc();
+
+	std::fill(data, data + m_capacity, 0.0f);
+	return Array(data);
+}
+
+
+Particles::Particles(size_t num) :
+	m_num(num),
+	m_capacity(((num + lanes - 1) / lanes) * lanes),
+	m_x(allocate()),
+	m_y(allocate()),
+	m_z(allocate()),
+	m_vx(allocate()),
+	m_vy(allocate()),
+	m_vz(allocate()),
+	m_mass(allocate()),
+	m_ax(allocate()),
+	m_ay(allocate()),
+	m_az(allocate())
+{
+}
+
+
+size_t Particles::size() const
+{
+	return m_num;
+}
+
+
+size_t Particles::capacity() const
+{
+	return m_capacity;
+}
+
+
+void Particles::load(const Vector4D* pos, const Vector4D* vel)
+{
+	for (size_t i = 0; i < m_num; i++)
+	{
+		m_x[i] = pos[i].x;
+		m_y[i] = pos[i].y;
+		m_z[i] = pos[i].z;
+		m_vx[i] = vel[i].x;
+		m_vy[i] = vel[i].y;
+		m_vz[i] = vel[i].z;
+	}
+}
+
+
+void Particles::fill_mass(float mass)
+{
+	std::fill(m_mass.get(), m_mass.get() + m_num, mass);
+}
+
+
+void Particles::store_positions(Vector4D* pos) const
+{
+	for (size_t i = 0; i < m_num; i++)
+	{
+		pos[i] = { m_x[i], m_y[i], m_z[i], 1.0f };
+	}
+}
+
+
+void Particles::store_velocities(Vector4D* vel) const
+{
+	for (size_t i = 0; i < m_num; i++)
+	{
+		vel[i] = { m_vx[i], m_vy[i], m_vz[i], 0.0f };
+	}
+}
+
+
+void Particles::load_accelerations(const Vector4D* acc)
+{
+	for (size_t i = 0; i < m_num; i++)
+	{
+		m_ax[i] = acc[i].x;
+		m_ay[i] = acc[i].y;
+		m_az[i] = acc[i].z;
+	}
+}
+
+
+void Particles::store_accelerations(Vector4D* acc) const
+{
+	for (size_t i = 0; i < m_num; i++)
+	{
+		acc[i] = { m_ax[i], m_ay[i], m_az[i], 0.0f };
+	}
+}
+
+
+float* Particles::x()
+{
+	return m_x.get();
+}
+
+
+float* Particles::y()
+{
+	return m_y.get();
+}
+
+
+float* Particles::z()
+{
+	return m_z.get();
+}
+
+
+float* Particles::vx()
+{
+	return m_vx.get();
+}
+
+
+float* Particles::vy()
+{
+	return m_vy.get();
+}
+
+
+float* Particles::vz()
+{
+	return m_vz.get();
+}
+
+
+float* Particles::mass()
+{
+	return m_mass.get();
+}
+
+
+float* Particles::ax()
+{
+	return m_ax.get();
+}
+
+
+float* Particles::ay()
+{
+	return m_ay.get();
+}
+
+
+float* Particles::az()
+{
+	return m_az.get();
+}
+
+
+const float* Particles::x() const
+{
+	return m_x.get();
+}
+
+
+const float* Particles::y() const
+{
+	return m_y.get();
+}
+
+
+const float* Particles::z() const
+{
+	return m_z.get();
+}
+
+
+const float* Particles::mass() const
+{
+	return m_mass.get();
+}
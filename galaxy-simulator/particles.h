@@ -0,0 +1,81 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "vector4d.h"
+#include <cstddef>
+#include <memory>
+
+class Particles
+{
+public:
+	static const size_t alignment = 64;
+	static const size_t lanes = alignment / sizeof(float);
+
+private:
+	struct Free
+	{
+		void operator()(float* data) const;
+	};
+
+	typedef std::unique_ptr<float[], Free> Array;
+
+	size_t m_num;
+	size_t m_capacity;
+	Array m_x;
+	Array m_y;
+	Array m_z;
+	Array m_vx;
+	Array m_vy;
+	Array m_vz;
+	Array m_mass;
+	Array m_ax;
+	Array m_ay;
+	Array m_az;
+
+	Array allocate() const;
+
+public:
+	Particles(size_t num);
+
+	size_t size() const;
+	size_t capacity() const;
+
+	void load(const Vector4D* pos, const Vector4D* vel);
+	void fill_mass(float mass);
+	void store_positions(Vector4D* pos) const;
+	void store_velocities(Vector4D* vel) const;
+	void load_accelerations(const Vector4D* acc);
+	void store_accelerations(Vector4D* acc) const;
+
+	float* x();
+	float* y();
+	float* z();
+	float* vx();
+	float* vy();
+	float* vz();
+	float* mass();
+	float* ax();
+	float* ay();
+	float* az();
+
+	const float* x() const;
+	const float* y() const;
+	const float* z() const;
+	const float* mass() const;
+};
+
+#endif
@@ -0,0 +1,72 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+struct Settings
+{
+	enum class Solver
+	{
+		DIRECT,
+		BARNES_HUT,
+		BARNES_HUT_HOST,
+		FMM,
+		PARTICLE_MESH,
+		TREE_PM,
+		DIRECT_SYMMETRIC
+	};
+
+	static const int num_solvers = 7;
+
+	enum class Integrator
+	{
+		EULER,
+		LEAPFROG,
+		BLOCK,
+		HERMITE
+	};
+
+	static const int num_integrators = 4;
+
+	enum class Accumulation
+	{
+		FLOAT,
+		KAHAN,
+		DOUBLE
+	};
+
+	static const int num_accumulations = 3;
+
+	Solver solver = Solver::DIRECT;
+	Integrator integrator = Integrator::LEAPFROG;
+	Accumulation accumulation = Accumulation::FLOAT;
+	float time_step = 0.01f;
+	int block_levels = 4;
+	float block_accuracy = 0.025f;
+	float opening_angle = 0.5f;
+	bool quadrupole = true;
+	int fmm_order = 4;
+	int pm_grid = 64;
+	float tree_pm_split = 2.0f;
+	float tree_pm_cutoff = 4.5f;
+	int reorder_interval = 64;
+
+	// passed to the OpenCL programs as build options
+	float mass = 0.00009f;
+	float radius = 0.05f;
+	float repulsion = 0.5f;
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "snapshots.h"
+
+
+Snapshots::Snapshots(size_t size) :
+	m_size(size),
+	m_back(0),
+	m_front(1),
+	m_middle(2)
+{
+	for (auto& slot : m_slots)
+	{
+		slot = std::make_unique<unsigned char[]>(size);
+	}
+}
+
+
+size_t Snapshots::size() const
+{
+	return m_size;
+}
+
+
+unsigned char* Snapshots::back()
+{
+	return m_slots[m_back].get();
+}
+
+
+void Snapshots::publish()
+{
+	// the producer's finished slot becomes the middle one; an unread middle is recycled as the next back slot
+	m_back = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel) & ~fresh;
+}
+
+
+const unsigned char* Snapshots::latest()
+{
+	if ((m_middle.load(std::memory_order_relaxed) & fresh) == 0) return nullptr;
+
+	m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~fresh;
+	return m_slots[m_front].get();
+}
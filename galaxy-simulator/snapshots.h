@@ -0,0 +1,44 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SNAPSHOTS_H
+#define SNAPSHOTS_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+class Snapshots
+{
+private:
+	static const unsigned fresh = 4;
+
+	const size_t m_size;
+	std::unique_ptr<unsigned char[]> m_slots[3];
+	unsigned m_back;
+	unsigned m_front;
+	std::atomic<unsigned> m_middle;
+
+public:
+	Snapshots(size_t size);
+	Snapshots(const Snapshots&) = delete;
+	Snapshots& operator=(const Snapshots&) = delete;
+
+	size_t size() const;
+	unsigned char* back();
+	void publish();
+	const unsigned char* latest();
+};
+
+#endif
@@ -13,61 +13,541 @@
 */
 
 
-constant float time_step = 0.01f;
-constant float mass = 0.00009f;
-constant float radius = 0.05f;
-constant float repulsion = 0.5f;
+// PRECISION_MIXED computes in double on float buffers, PRECISION_DOUBLE also stores double
+#if defined(PRECISION_DOUBLE) || defined(PRECISION_MIXED)
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+typedef double real;
+typedef double3 real3;
+typedef double4 real4;
+#define convert_real3 convert_double3
+#define convert_real4 convert_double4
+#else
+typedef float real;
+typedef float3 real3;
+typedef float4 real4;
+#define convert_real3 convert_float3
+#define convert_real4 convert_float4
+#endif
 
+#ifdef PRECISION_DOUBLE
+typedef double4 store4;
+#define convert_store4 convert_double4
+#else
+typedef float4 store4;
+#define convert_store4 convert_float4
+#endif
 
-unsigned long indx(unsigned long i, unsigned long j)
+
+// the host builds a program per parameter set, so these fold into the kernels as literals
+#ifndef MASS
+#define MASS 0.00009f
+#endif
+
+#ifndef RADIUS
+#define RADIUS 0.05f
+#endif
+
+#ifndef REPULSION
+#define REPULSION 0.5f
+#endif
+
+// quantisation scale of snorm16 render positions, always passed by the host which draws them
+#ifndef SNORM16_SCALE
+#error SNORM16_SCALE must be defined
+#endif
+
+// inner force loop unroll factor, chosen per device by the tuner
+#ifndef UNROLL
+#define UNROLL 1
+#endif
+
+constant float mass = MASS;
+constant float radius = RADIUS;
+constant float repulsion = REPULSION;
+
+
+real4 interaction(real4 pos_i, real4 pos_j)
 {
-	return (j * (j - 1) / 2 + i);
+	real4 d = pos_j - pos_i;
+	real r = length(d);
+
+	if (r > radius)
+		return (mass / r / r / r) * d;
+	else
+		return -repulsion * d;
+}
+
+
+kernel void drift(global store4* pos, global store4* vel, unsigned int num, float time_step)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	real4 vel_i = convert_real4(vel[i]);
+	real4 pos_i = convert_real4(pos[i]) + (real4)(time_step * vel_i.xyz, 0.0f);
+
+	if (length(pos_i.xyz) > 1.0f)
+	{
+		real3 pos_norm = normalize(pos_i.xyz);
+		pos_i = (real4)(2.0f * pos_norm - pos_i.xyz, 1.0f);
+		vel[i] = convert_store4((real4)(vel_i.xyz - dot(pos_norm, vel_i.xyz) * pos_norm, 0.0f));
+	}
+
+	pos[i] = convert_store4(pos_i);
+}
+
+
+kernel void accelerate(global const store4* pos, global store4* acc, local store4* tile, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	unsigned int l = get_local_id(0);
+	unsigned int tile_size = get_local_size(0);
+
+	real4 pos_i = (i < num) ? convert_real4(pos[i]) : (real4)(0.0f, 0.0f, 0.0f, 1.0f);
+	real4 acc_i = (real4)(0.0f, 0.0f, 0.0f, 0.0f);
+
+	for (unsigned int tile_start = 0; tile_start < num; tile_start += tile_size)
+	{
+		if (tile_start + l < num)
+			tile[l] = pos[tile_start + l];
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if (i < num)
+		{
+			unsigned int tile_end = min(tile_size, num - tile_start);
+			unsigned int k = 0;
+
+			for (; k + UNROLL <= tile_end; k += UNROLL)
+			{
+				for (unsigned int u = 0; u < UNROLL; u++)
+					acc_i += interaction(pos_i, convert_real4(tile[k + u]));
+			}
+
+			for (; k < tile_end; k++)
+				acc_i += interaction(pos_i, convert_real4(tile[k]));
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (i < num)
+		acc[i] = convert_store4(acc_i);
+}
+
+
+kernel void accelerate_kahan(global const store4* pos, global store4* acc, local store4* tile, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	unsigned int l = get_local_id(0);
+	unsigned int tile_size = get_local_size(0);
+
+	real4 pos_i = (i < num) ? convert_real4(pos[i]) : (real4)(0.0f, 0.0f, 0.0f, 1.0f);
+	real4 acc_i = (real4)(0.0f, 0.0f, 0.0f, 0.0f);
+	real4 comp = (real4)(0.0f, 0.0f, 0.0f, 0.0f);
+
+	for (unsigned int tile_start = 0; tile_start < num; tile_start += tile_size)
+	{
+		if (tile_start + l < num)
+			tile[l] = pos[tile_start + l];
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if (i < num)
+		{
+			unsigned int tile_end = min(tile_size, num - tile_start);
+
+			for (unsigned int k = 0; k < tile_end; k++)
+			{
+				real4 term = interaction(pos_i, convert_real4(tile[k])) - comp;
+				real4 sum = acc_i + term;
+				comp = (sum - acc_i) - term;
+				acc_i = sum;
+			}
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (i < num)
+		acc[i] = convert_store4(acc_i);
 }
 
 
-kernel void propagate(global float4* pos, global float4* vel, global float* acc_matr)
+#ifdef cl_khr_fp64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+
+kernel void accelerate_double(global const store4* pos, global store4* acc, local store4* tile, unsigned int num)
 {
-	unsigned long i = get_global_id(0);
+	unsigned int i = get_global_id(0);
+	unsigned int l = get_local_id(0);
+	unsigned int tile_size = get_local_size(0);
 
-	pos[i] = pos[i] + (float4)(time_step * vel[i].xyz, 0.0f);
+	real4 pos_i = (i < num) ? convert_real4(pos[i]) : (real4)(0.0f, 0.0f, 0.0f, 1.0f);
+	double4 acc_i = (double4)(0.0, 0.0, 0.0, 0.0);
 
-	if (length(pos[i].xyz) > 1.0f)
+	for (unsigned int tile_start = 0; tile_start < num; tile_start += tile_size)
 	{
-		float3 pos_norm = normalize(pos[i].xyz);
-		pos[i] = (float4)(2.0f * pos_norm - pos[i].xyz, 1.0f);
-		vel[i] = (float4)(vel[i].xyz - dot(pos_norm, vel[i].xyz) * pos_norm, 0.0f);
+		if (tile_start + l < num)
+			tile[l] = pos[tile_start + l];
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if (i < num)
+		{
+			unsigned int tile_end = min(tile_size, num - tile_start);
+
+			for (unsigned int k = 0; k < tile_end; k++)
+				acc_i += convert_double4(interaction(pos_i, convert_real4(tile[k])));
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
 	}
 
-	barrier(CLK_GLOBAL_MEM_FENCE);
+	if (i < num)
+		acc[i] = convert_store4(acc_i);
+}
+#endif
+
+
+kernel void kick(global store4* vel, global const store4* acc, unsigned int num, float time_step)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	real4 vel_i = convert_real4(vel[i]) + time_step * convert_real4(acc[i]);
+
+	if (length(vel_i) > 1.0f)
+		vel_i = normalize(vel_i);
+
+	vel[i] = convert_store4(vel_i);
+}
+
+
+kernel void accelerate_tree(global const store4* pos, global store4* acc,
+	global const float4* node_com, global const float4* node_quad_diag, global const float4* node_quad_offdiag,
+	global const int4* node_link, global const int* body, float opening_angle, int quadrupole, unsigned int num)
+{
+	unsigned int k = get_global_id(0);
+	if (k >= num) return;
+
+	int i = body[k];
+	real4 pos_i = convert_real4(pos[i]);
+	real4 acc_i = (real4)(0.0f, 0.0f, 0.0f, 0.0f);
+	int node = 0;
 
-	for (unsigned long j = i + 1; j < get_global_size(0); j++)
+	while (node >= 0)
 	{
-		float r = distance(pos[i], pos[j]);
+		int4 link = node_link[node];
 
-		if (r > radius)
+		if (link.w != 0)
 		{
-			acc_matr[indx(i, j)] = mass / r / r / r;
+			for (int b = link.y; b < link.y + link.z; b++)
+				acc_i += interaction(pos_i, convert_real4(pos[body[b]]));
+
+			node = link.x;
+			continue;
+		}
+
+		real4 com = convert_real4(node_com[node]);
+		real4 quad_diag = convert_real4(node_quad_diag[node]);
+		real3 d = com.xyz - pos_i.xyz;
+		real r = length(d);
+
+		if ((quad_diag.w < opening_angle * r) && (r > radius + quad_diag.w))
+		{
+			real inv_r = 1.0f / r;
+			real inv_r3 = inv_r * inv_r * inv_r;
+			real3 a = com.w * inv_r3 * d;
+
+			if (quadrupole != 0)
+			{
+				real4 quad_offdiag = convert_real4(node_quad_offdiag[node]);
+				real3 q = (real3)(
+					quad_diag.x * d.x + quad_offdiag.x * d.y + quad_offdiag.y * d.z,
+					quad_offdiag.x * d.x + quad_diag.y * d.y + quad_offdiag.z * d.z,
+					quad_offdiag.y * d.x + quad_offdiag.z * d.y + quad_diag.z * d.z);
+
+				real inv_r5 = inv_r3 * inv_r * inv_r;
+				a += 2.5f * dot(d, q) * inv_r5 * inv_r * inv_r * d - inv_r5 * q;
+			}
+
+			acc_i += (real4)(a, 0.0f);
+			node = link.x;
 		}
 		else
 		{
-			acc_matr[indx(i, j)] = -repulsion;
+			node++;
 		}
 	}
 
-	barrier(CLK_GLOBAL_MEM_FENCE);
+	acc[i] = convert_store4(acc_i);
+}
+
+
+kernel void collect_active(global const int* level, global unsigned int* active, volatile global unsigned int* num_active,
+	unsigned int boundary, int max_level, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	if ((boundary & ((1u << (max_level - level[i])) - 1u)) == 0)
+		active[atomic_inc(num_active)] = i;
+}
+
+
+kernel void accelerate_active(global const store4* pos, global store4* acc, local store4* tile,
+	global const unsigned int* active, global const unsigned int* num_active, unsigned int num)
+{
+	unsigned int k = get_global_id(0);
+	unsigned int l = get_local_id(0);
+	unsigned int tile_size = get_local_size(0);
+	unsigned int count = *num_active;
 
-	float4 acc = (float4)(0.0f, 0.0f, 0.0f, 0.0f);
-	for (unsigned long j = 0; j < i; j++)
+	if (get_group_id(0) * tile_size >= count) return;
+
+	unsigned int i = (k < count) ? active[k] : 0;
+	real4 pos_i = convert_real4(pos[i]);
+	real4 acc_i = (real4)(0.0f, 0.0f, 0.0f, 0.0f);
+
+	for (unsigned int tile_start = 0; tile_start < num; tile_start += tile_size)
 	{
-		acc += acc_matr[indx(j, i)] * (pos[j] - pos[i]);
+		if (tile_start + l < num)
+			tile[l] = pos[tile_start + l];
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if (k < count)
+		{
+			unsigned int tile_end = min(tile_size, num - tile_start);
+
+			for (unsigned int t = 0; t < tile_end; t++)
+				acc_i += interaction(pos_i, convert_real4(tile[t]));
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
 	}
-	for (unsigned long j = i + 1; j < get_global_size(0); j++)
+
+	if (k < count)
+		acc[i] = convert_store4(acc_i);
+}
+
+
+kernel void kick_block(global store4* vel, global const store4* acc, global int* level,
+	global const unsigned int* active, global const unsigned int* num_active,
+	float time_step, int max_level, unsigned int boundary, int close, int open, float accuracy)
+{
+	unsigned int k = get_global_id(0);
+	if (k >= *num_active) return;
+
+	unsigned int i = active[k];
+	real4 acc_i = convert_real4(acc[i]);
+	int level_i = level[i];
+	real dt = 0.0f;
+
+	if (close != 0)
+		dt += 0.5f * time_step / (real)(1 << level_i);
+
+	if (open != 0)
 	{
-		acc += acc_matr[indx(i, j)] * (pos[j] - pos[i]);
+		float acc_norm = length(convert_float3(acc_i.xyz));
+		level_i = 0;
+
+		if (acc_norm > 0.0f)
+		{
+			float dt_wanted = sqrt(2.0f * accuracy * radius / acc_norm);
+			level_i = clamp((int)ceil(log2(time_step / dt_wanted)), 0, max_level);
+		}
+
+		while ((level_i < max_level) && ((boundary & ((1u << (max_level - level_i)) - 1u)) != 0))
+			level_i++;
+
+		level[i] = level_i;
+		dt += 0.5f * time_step / (real)(1 << level_i);
 	}
 
-	vel[i] = vel[i] + time_step * acc;
+	real4 vel_i = convert_real4(vel[i]) + dt * acc_i;
+
+	if (length(vel_i) > 1.0f)
+		vel_i = normalize(vel_i);
+
+	vel[i] = convert_store4(vel_i);
+}
+
+
+kernel void accelerate_jerk(global const store4* pos, global const store4* vel, global store4* acc, global store4* jerk,
+	local store4* tile_pos, local store4* tile_vel, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	unsigned int l = get_local_id(0);
+	unsigned int tile_size = get_local_size(0);
+
+	real4 pos_i = (i < num) ? convert_real4(pos[i]) : (real4)(0.0f, 0.0f, 0.0f, 1.0f);
+	real4 vel_i = (i < num) ? convert_real4(vel[i]) : (real4)(0.0f, 0.0f, 0.0f, 0.0f);
+	real4 acc_i = (real4)(0.0f, 0.0f, 0.0f, 0.0f);
+	real4 jerk_i = (real4)(0.0f, 0.0f, 0.0f, 0.0f);
+
+	for (unsigned int tile_start = 0; tile_start < num; tile_start += tile_size)
+	{
+		if (tile_start + l < num)
+		{
+			tile_pos[l] = pos[tile_start + l];
+			tile_vel[l] = vel[tile_start + l];
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		if (i < num)
+		{
+			unsigned int tile_end = min(tile_size, num - tile_start);
+
+			for (unsigned int k = 0; k < tile_end; k++)
+			{
+				real3 d = convert_real3(tile_pos[k].xyz) - pos_i.xyz;
+				real3 dv = convert_real3(tile_vel[k].xyz) - vel_i.xyz;
+				real r = length(d);
+
+				if (r > radius)
+				{
+					real inv_r2 = 1.0f / (r * r);
+					real coef = mass * inv_r2 / r;
+					acc_i.xyz += coef * d;
+					jerk_i.xyz += coef * (dv - 3.0f * dot(d, dv) * inv_r2 * d);
+				}
+				else
+				{
+					acc_i.xyz -= repulsion * d;
+					jerk_i.xyz -= repulsion * dv;
+				}
+			}
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (i < num)
+	{
+		acc[i] = convert_store4(acc_i);
+		jerk[i] = convert_store4(jerk_i);
+	}
+}
+
+
+kernel void hermite_predict(global store4* pos, global store4* vel, global const store4* acc, global const store4* jerk,
+	global store4* pos_old, global store4* vel_old, global store4* acc_old, global store4* jerk_old,
+	unsigned int num, float time_step)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	real dt = time_step;
+	real4 pos_i = convert_real4(pos[i]);
+	real4 vel_i = convert_real4(vel[i]);
+	real4 acc_i = convert_real4(acc[i]);
+	real4 jerk_i = convert_real4(jerk[i]);
+
+	pos_old[i] = pos[i];
+	vel_old[i] = vel[i];
+	acc_old[i] = acc[i];
+	jerk_old[i] = jerk[i];
+
+	pos[i] = convert_store4((real4)(pos_i.xyz + dt * (vel_i.xyz + dt * (0.5f * acc_i.xyz + dt * (1.0f / 6.0f) * jerk_i.xyz)), pos_i.w));
+	vel[i] = convert_store4((real4)(vel_i.xyz + dt * (acc_i.xyz + dt * 0.5f * jerk_i.xyz), 0.0f));
+}
+
+
+kernel void hermite_correct(global store4* pos, global store4* vel, global const store4* acc, global const store4* jerk,
+	global const store4* pos_old, global const store4* vel_old, global const store4* acc_old, global const store4* jerk_old,
+	unsigned int num, float time_step)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	real dt = time_step;
+	real3 acc_0 = convert_real3(acc_old[i].xyz), acc_1 = convert_real3(acc[i].xyz);
+	real3 jerk_0 = convert_real3(jerk_old[i].xyz), jerk_1 = convert_real3(jerk[i].xyz);
+	real3 vel_0 = convert_real3(vel_old[i].xyz);
+
+	real3 vel_1 = vel_0 + 0.5f * dt * (acc_0 + acc_1) + (dt * dt / 12.0f) * (jerk_0 - jerk_1);
+	real3 pos_1 = convert_real3(pos_old[i].xyz) + 0.5f * dt * (vel_0 + vel_1) + (dt * dt / 12.0f) * (acc_0 - acc_1);
+
+	if (length(pos_1) > 1.0f)
+	{
+		real3 pos_norm = normalize(pos_1);
+		pos_1 = 2.0f * pos_norm - pos_1;
+		vel_1 = vel_1 - dot(pos_norm, vel_1) * pos_norm;
+	}
+
+	if (length(vel_1) > 1.0f)
+		vel_1 = normalize(vel_1);
+
+	pos[i] = convert_store4((real4)(pos_1, 1.0f));
+	vel[i] = convert_store4((real4)(vel_1, 0.0f));
+}
+
+
+unsigned int spread_bits(unsigned int v)
+{
+	v &= 0x3ffu;
+	v = (v | (v << 16)) & 0x030000ffu;
+	v = (v | (v << 8)) & 0x0300f00fu;
+	v = (v | (v << 4)) & 0x030c30c3u;
+	v = (v | (v << 2)) & 0x09249249u;
+	return v;
+}
+
+
+kernel void morton_keys(global const store4* pos, global unsigned int* key, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	uint3 cell = convert_uint3(clamp((convert_float3(pos[i].xyz) + 1.0f) * 512.0f, 0.0f, 1023.0f));
+	key[i] = spread_bits(cell.x) | (spread_bits(cell.y) << 1) | (spread_bits(cell.z) << 2);
+}
+
+
+kernel void gather(global store4* dst, global const store4* src, global const int* order, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	dst[i] = src[order[i]];
+}
+
+
+kernel void gather_int(global int* dst, global const int* src, global const int* order, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	dst[i] = src[order[i]];
+}
+
+
+kernel void publish(global float4* render, global const store4* pos, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	render[i] = convert_float4(pos[i]);
+}
+
+
+kernel void publish_half(global half* render, global const store4* pos, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
+
+	vstore_half4(convert_float4(pos[i]), i, render);
+}
+
+
+kernel void publish_snorm16(global short4* render, global const store4* pos, unsigned int num)
+{
+	unsigned int i = get_global_id(0);
+	if (i >= num) return;
 
-	if (length(vel[i]) > 1.0f)
-		vel[i] = normalize(vel[i]);
+	float3 pos_i = clamp(convert_float3(pos[i].xyz), -1.0f, 1.0f);
+	render[i] = convert_short4_sat_rte((float4)(pos_i * SNORM16_SCALE, 1.0f));
 }
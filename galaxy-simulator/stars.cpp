@@ -14,103 +14,155 @@
 
 
 #include "stars.h"
-#include "stars_ocl.h"
+#include <algorithm>
+#include <chrono>
 #include <random>
 #include <stdexcept>
-#include <string>
 
-#ifdef DEBUG
-#include <fstream>
+#ifdef HEADLESS
+static const bool headless_build = true;
+#else
+static const bool headless_build = false;
 #endif
 
 
-Stars::Stars(GLulong num) :
-	m_initialised(false),
+Stars::Stars(GLulong num, unsigned seed) :
 	m_num((num < 2) ? 2 : num),
-	m_vbo(0),
-	m_vel(std::make_unique<Vector4D[]>(m_num)),
-	m_ocl_context(nullptr),
-	m_ocl_cmd_queue(nullptr),
-	m_ocl_kernel(nullptr),
-	m_ocl_buffer_pos(nullptr),
-	m_ocl_buffer_vel(nullptr),
-	m_ocl_buffer_acc(nullptr)
+	m_seed(seed),
+	m_initialised(false),
+	m_headless(false),
+	m_vbos(),
+	m_vbo_draw(0),
+	m_backend_kind(Backend::Kind::OPENCL_GPU),
+	m_precision(Backend::Precision::FLOAT),
+	m_packing(Backend::Packing::FLOAT),
+	m_waiting(0),
+	m_simulating(false),
+	m_failed(false),
+	m_stepped(false)
+{
+}
+
+
+std::unique_lock<std::mutex> Stars::acquire() const
 {
+	// std::mutex is not fair, so the worker steps aside while anyone has announced themselves here
+	m_waiting++;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_waiting--;
+	m_handover.notify_all();
+	return lock;
 }
 
 
 void Stars::release()
 {
+	stop_simulation();
+
 	if (m_initialised)
 	{
-		if (m_ocl_cmd_queue != nullptr)
+		if (m_backend)
 		{
-			clFinish(m_ocl_cmd_queue);
-			clReleaseCommandQueue(m_ocl_cmd_queue);
-			m_ocl_cmd_queue = nullptr;
+			m_backend->release();
+			m_backend.reset();
 		}
 
-		if (m_ocl_kernel != nullptr)
+#ifndef HEADLESS
+		if (m_vbos[0] != 0)
 		{
-			clReleaseKernel(m_ocl_kernel);
-			m_ocl_kernel = nullptr;
-		}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glDeleteBuffers(num_vbos, m_vbos);
 
-		if (m_ocl_context != nullptr)
-		{
-			clReleaseContext(m_ocl_context);
-			m_ocl_context = nullptr;
+			for (GLuint& vbo : m_vbos)
+				vbo = 0;
 		}
+#endif
 
-		if (m_ocl_buffer_pos != nullptr)
-		{
-			clReleaseMemObject(m_ocl_buffer_pos);
-			m_ocl_buffer_pos = nullptr;
-		}
+		m_initialised = false;
+	}
+}
 
-		if (m_ocl_buffer_vel != nullptr)
-		{
-			clReleaseMemObject(m_ocl_buffer_vel);
-			m_ocl_buffer_vel = nullptr;
-		}
 
-		if (m_ocl_buffer_acc != nullptr)
-		{
-			clReleaseMemObject(m_ocl_buffer_acc);
-			m_ocl_buffer_acc = nullptr;
-		}
+Stars::~Stars()
+{
+	release();
+}
 
-		if (m_vbo != 0)
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-			glDeleteBuffers(1, &m_vbo);
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			m_vbo = 0;
-		}
 
-		m_initialised = false;
+void Stars::fill_vbos(const Vector4D* pos)
+{
+#ifdef HEADLESS
+	static_cast<void>(pos);
+#else
+	// headless stars live in the backend only
+	if (m_headless) return;
+
+	const size_t size = m_num * Backend::packed_size(m_packing);
+	auto packed = std::make_unique<unsigned char[]>(size);
+	Backend::pack(m_packing, pos, m_num, packed.get());
+
+	if (m_vbos[0] == 0)
+		glGenBuffers(num_vbos, m_vbos);
+
+	for (GLuint vbo : m_vbos)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, size, packed.get(), GL_DYNAMIC_DRAW);
 	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_vbo_draw = 0;
+#endif
 }
 
 
-Stars::~Stars()
+void Stars::start_backend(const Vector4D* pos, const Vector4D* vel)
 {
-	release();
+	// OpenCL needs the GL context, so headless stars step on the host
+	const bool opencl = (m_backend_kind == Backend::Kind::OPENCL_GPU) || (m_backend_kind == Backend::Kind::OPENCL_CPU);
+	const Backend::Kind kind = (m_headless && opencl) ? Backend::Kind::HOST_SIMD : m_backend_kind;
+	const size_t vbos = m_headless ? 0 : num_vbos;
+
+	m_backend = Backend::create(kind, m_num, m_precision, m_packing);
+
+	if (!m_backend->init(m_settings, m_vbos, vbos, pos, vel))
+	{
+		m_backend->release();
+		m_backend = Backend::create(Backend::Kind::HOST_SIMD, m_num, m_precision, m_packing);
+		m_backend->init(m_settings, m_vbos, vbos, pos, vel);
+	}
+}
+
+
+void Stars::restart_backend()
+{
+	auto pos = std::make_unique<Vector4D[]>(m_num);
+	auto vel = std::make_unique<Vector4D[]>(m_num);
+
+	m_backend->state(pos.get(), vel.get());
+	m_backend->release();
+	m_backend.reset();
+
+	fill_vbos(pos.get());
+	start_backend(pos.get(), vel.get());
+
+	// snapshots of the old backend or packing are dropped
+	if (m_snapshots)
+		m_snapshots = std::make_unique<Snapshots>(m_num * Backend::packed_size(m_packing));
 }
 
 
-void Stars::init()
+void Stars::init(bool headless)
 {
 	if (!m_initialised)
 	{
-		std::random_device gen;
+		m_headless = headless || headless_build;
+
+		std::mt19937 gen((m_seed != 0) ? m_seed : std::random_device()());
 		std::uniform_real_distribution<GLfloat> distrib_pos(-0.5f, 0.5f);
 
-		glGenBuffers(1, &m_vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glBufferData(GL_ARRAY_BUFFER, m_num * sizeof(Vector4D), nullptr, GL_STATIC_DRAW);
-		
-		auto pos = reinterpret_cast<Vector4D*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+		auto pos = std::make_unique<Vector4D[]>(m_num);
+		auto vel = std::make_unique<Vector4D[]>(m_num);
 
 		for (GLsizei i = 0; i < m_num; i++)
 		{
@@ -119,245 +171,366 @@ void Stars::init()
 			pos[i].z = 0.0f;
 			pos[i].w = 1.0f;
 
-			m_vel[i].x = -pos[i].y;
-			m_vel[i].y = pos[i].x;
-			m_vel[i].z = 0.0f;
-			m_vel[i].w = 0.0f;
+			vel[i].x = -pos[i].y;
+			vel[i].y = pos[i].x;
+			vel[i].z = 0.0f;
+			vel[i].w = 0.0f;
 		}
 
-		glUnmapBuffer(GL_ARRAY_BUFFER);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		fill_vbos(pos.get());
+		start_backend(pos.get(), vel.get());
+		m_initialised = true;
+	}
+	else
+	{
+		throw std::runtime_error("Already initialised.");
+	}
+}
 
-		cl_uint ocl_num_platforms;
-		clGetPlatformIDs(0, nullptr, &ocl_num_platforms);
-		if (ocl_num_platforms == 0)
-		{
-			release();
-			throw std::exception("No OpenCL platforms found.");
-		}
 
-		auto ocl_platforms = std::make_unique<cl_platform_id[]>(ocl_num_platforms);
-		clGetPlatformIDs(ocl_num_platforms, ocl_platforms.get(), nullptr);
-		
-		for (cl_uint i = 0; i < ocl_num_platforms + 1; i++)
+void Stars::calculate(unsigned steps)
+{
+	if (m_initialised)
+	{
+		const auto lock = acquire();
+
+		// the last step is published to the next VBO of the ring while the current one may still be drawn
+		const size_t slot = (m_vbo_draw + 1) % num_vbos;
+
+		m_backend->step(m_settings, steps);
+
+		if (!m_headless)
 		{
-			if (i == ocl_num_platforms)
-			{
-				release();
-				throw std::exception("Cannot initialise OpenCL.");
-			}
-			else
-			{
-				cl_context_properties ocl_context_properties[] =
-				{
-					CL_GL_CONTEXT_KHR, reinterpret_cast<cl_context_properties>(wglGetCurrentContext()),
-					CL_WGL_HDC_KHR, reinterpret_cast<cl_context_properties>(wglGetCurrentDC()),
-					CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(ocl_platforms[i]),
-					0
-				};
-				
-				cl_int ocl_err;
-				m_ocl_context = clCreateContextFromType(ocl_context_properties, CL_DEVICE_TYPE_GPU, nullptr, nullptr, &ocl_err);
-				if (ocl_err != CL_SUCCESS) continue;
-
-				size_t ocl_devices_size;
-				clGetContextInfo(m_ocl_context, CL_CONTEXT_DEVICES, 0, nullptr, &ocl_devices_size);
-				size_t ocl_num_devices = ocl_devices_size / sizeof(cl_device_id);
-				if (ocl_num_devices != 1)
-				{
-					clReleaseContext(m_ocl_context);
-					continue;
-				}
+			m_backend->map_positions(slot);
+			m_vbo_draw = slot;
+		}
 
-				cl_device_id ocl_device;
-				clGetContextInfo(m_ocl_context, CL_CONTEXT_DEVICES, sizeof(cl_device_id), &ocl_device, nullptr);
+		m_backend->finish();
+	}
+	else
+	{
+		throw std::runtime_error("Not initialised.");
+	}
+}
 
-				m_ocl_cmd_queue = clCreateCommandQueue(m_ocl_context, ocl_device, 0, &ocl_err);
-				if (ocl_err != CL_SUCCESS)
-				{
-					clReleaseContext(m_ocl_context);
-					continue;
-				}
 
-				cl_program ocl_program = clCreateProgramWithSource(m_ocl_context, 1, &ocl_src_stars, nullptr, &ocl_err);
-				if (ocl_err != CL_SUCCESS)
-				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					continue;
-				}
+void Stars::finish()
+{
+	if (m_initialised)
+	{
+		// the OpenCL backend only flushes its queue, so wait on the host before reading a clock
+		const auto lock = acquire();
+		m_backend->finish();
+	}
+	else
+	{
+		throw std::runtime_error("Not initialised.");
+	}
+}
 
-				ocl_err = clBuildProgram(ocl_program, 1, &ocl_device, "-cl-fast-relaxed-math", nullptr, nullptr);
 
-#ifdef DEBUG
-				size_t log_str_size;
-				clGetProgramBuildInfo(ocl_program, ocl_device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_str_size);
+void Stars::start_simulation(double rate, unsigned steps)
+{
+	if (!m_initialised) throw std::runtime_error("Not initialised.");
 
-				auto log_str = std::make_unique<char[]>(log_str_size);
-				clGetProgramBuildInfo(ocl_program, ocl_device, CL_PROGRAM_BUILD_LOG, log_str_size, log_str.get(), nullptr);
+	stop_simulation();
 
-				std::ofstream log_file("ocl_build_log_" + std::to_string(i) + ".txt");
-				log_file << log_str.get();
-				log_file.close();
-#endif
+	m_failed = false;
+	m_stepped = false;
+	m_error = nullptr;
+	m_snapshots = std::make_unique<Snapshots>(m_num * Backend::packed_size(m_packing));
+	m_simulating = true;
+	m_thread = std::thread(&Stars::simulate, this, rate, (steps > 0) ? steps : 1);
+}
 
-				if (ocl_err != CL_SUCCESS)
-				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					clReleaseProgram(ocl_program);
-					continue;
-				}
 
-				m_ocl_kernel = clCreateKernel(ocl_program, "propagate", &ocl_err);
-				clReleaseProgram(ocl_program);
+void Stars::stop_simulation()
+{
+	m_simulating = false;
 
-				if (ocl_err != CL_SUCCESS)
-				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					continue;
-				}
+	if (m_thread.joinable())
+		m_thread.join();
 
-				m_ocl_buffer_pos = clCreateFromGLBuffer(m_ocl_context, CL_MEM_READ_WRITE, m_vbo, &ocl_err);
-				if (ocl_err != CL_SUCCESS)
-				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					clReleaseKernel(m_ocl_kernel);
-					continue;
-				}
+	m_snapshots.reset();
+}
 
-				m_ocl_buffer_vel = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
-					m_num * sizeof(Vector4D), m_vel.get(), &ocl_err);
 
-				if (ocl_err != CL_SUCCESS)
-				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					clReleaseKernel(m_ocl_kernel);
-					clReleaseMemObject(m_ocl_buffer_pos);
-					continue;
-				}
+void Stars::simulate(double rate, unsigned steps)
+{
+	auto pos = std::make_unique<Vector4D[]>(m_num);
+	const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>((rate > 0.0) ? (steps / rate) : 0.0));
+	auto next = std::chrono::steady_clock::now();
 
-				m_ocl_buffer_acc = clCreateBuffer(m_ocl_context, CL_MEM_READ_WRITE,
-					(m_num * (m_num - 1) / 2) * sizeof(cl_float), nullptr, &ocl_err);
+	try
+	{
+		while (m_simulating)
+		{
+			{
+				// the render thread takes the lock to change settings or the backend, and to publish shared buffers
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_handover.wait(lock, [this] { return m_waiting == 0; });
 
-				if (ocl_err != CL_SUCCESS)
-				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					clReleaseKernel(m_ocl_kernel);
-					clReleaseMemObject(m_ocl_buffer_pos);
-					clReleaseMemObject(m_ocl_buffer_vel);
-					continue;
-				}
+				m_backend->step(m_settings, steps);
 
-				ocl_err = clSetKernelArg(m_ocl_kernel, 0, sizeof(cl_mem), &m_ocl_buffer_pos);
-				if (ocl_err != CL_SUCCESS)
+				if (m_backend->shares_gl())
 				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					clReleaseKernel(m_ocl_kernel);
-					clReleaseMemObject(m_ocl_buffer_pos);
-					clReleaseMemObject(m_ocl_buffer_vel);
-					clReleaseMemObject(m_ocl_buffer_acc);
-					continue;
+					// GL calls belong to the render thread, which publishes the positions straight into its VBO
+					m_backend->finish();
+					m_stepped = true;
 				}
-
-				ocl_err = clSetKernelArg(m_ocl_kernel, 1, sizeof(cl_mem), &m_ocl_buffer_vel);
-				if (ocl_err != CL_SUCCESS)
+				else
 				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					clReleaseKernel(m_ocl_kernel);
-					clReleaseMemObject(m_ocl_buffer_pos);
-					clReleaseMemObject(m_ocl_buffer_vel);
-					clReleaseMemObject(m_ocl_buffer_acc);
-					continue;
+					m_backend->positions(pos.get());
+					Backend::pack(m_packing, pos.get(), m_num, m_snapshots->back());
+					m_snapshots->publish();
 				}
+			}
 
-				ocl_err = clSetKernelArg(m_ocl_kernel, 2, sizeof(cl_mem), &m_ocl_buffer_acc);
-				if (ocl_err != CL_SUCCESS)
-				{
-					clReleaseContext(m_ocl_context);
-					clReleaseCommandQueue(m_ocl_cmd_queue);
-					clReleaseKernel(m_ocl_kernel);
-					clReleaseMemObject(m_ocl_buffer_pos);
-					clReleaseMemObject(m_ocl_buffer_vel);
-					clReleaseMemObject(m_ocl_buffer_acc);
-					continue;
-				}
-				
-				break;
+			if (rate > 0.0)
+			{
+				// a late batch resets the schedule instead of bursting to catch up
+				next = std::max(next + period, std::chrono::steady_clock::now());
+				std::this_thread::sleep_until(next);
+			}
+			else
+			{
+				std::this_thread::yield();
 			}
 		}
-
-		m_initialised = true;
 	}
-	else
+	catch (...)
 	{
-		throw std::exception("Already initialised.");
+		m_error = std::current_exception();
+		m_failed = true;
 	}
 }
 
 
-void Stars::calculate()
+#ifndef HEADLESS
+void Stars::update()
 {
-	if (m_initialised)
+	if (m_headless) throw std::runtime_error("Headless stars have no VBOs.");
+
+	if (m_failed)
 	{
-		glFinish();
+		const std::exception_ptr error = m_error;
+		stop_simulation();
 
-		cl_int ocl_err = clEnqueueAcquireGLObjects(m_ocl_cmd_queue, 1, &m_ocl_buffer_pos, 0, nullptr, nullptr);
-		if (ocl_err != CL_SUCCESS)
-		{
-			release();
-			throw std::exception("OpenCL cannot acquire OpenGL buffer.");
-		}
+		// the worker cannot delete GL objects, so a backend that failed there is released on this thread
+		m_backend->release();
+		std::rethrow_exception(error);
+	}
 
-		const size_t ocl_global_work_size = m_num;
-		ocl_err = clEnqueueNDRangeKernel(m_ocl_cmd_queue, m_ocl_kernel, 1, nullptr, &ocl_global_work_size, nullptr, 0, nullptr, nullptr);
-		if (ocl_err != CL_SUCCESS)
-		{
-			release();
-			throw std::exception("OpenCL cannot run kernel.");
-		}
+	if (!m_snapshots) throw std::runtime_error("Simulation not running.");
 
-		ocl_err = clEnqueueReleaseGLObjects(m_ocl_cmd_queue, 1, &m_ocl_buffer_pos, 0, nullptr, nullptr);
-		if (ocl_err != CL_SUCCESS)
-		{
-			release();
-			throw std::exception("OpenCL cannot release OpenGL buffer.");
-		}
+	const size_t slot = (m_vbo_draw + 1) % num_vbos;
+
+	if (m_stepped.exchange(false))
+	{
+		const auto lock = acquire();
 
-		ocl_err = clFinish(m_ocl_cmd_queue);
-		if (ocl_err != CL_SUCCESS)
+		// the backend may have been restarted without shared buffers since the step
+		if (m_backend->shares_gl())
 		{
-			release();
-			throw std::exception("OpenCL cannot finish.");
+			m_backend->map_positions(slot);
+			m_vbo_draw = slot;
+			return;
 		}
 	}
+
+	const unsigned char* snapshot = m_snapshots->latest();
+	if (snapshot == nullptr) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbos[slot]);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_snapshots->size(), snapshot);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_vbo_draw = slot;
+}
+#endif
+
+
+void Stars::accelerations(Vector4D* acc)
+{
+	if (m_initialised)
+	{
+		const auto lock = acquire();
+		m_backend->accelerations(m_settings, acc);
+	}
+	else
+	{
+		throw std::runtime_error("Not initialised.");
+	}
+}
+
+
+void Stars::positions(Vector4D* pos)
+{
+	if (m_initialised)
+	{
+		// the VBO may hold packed positions, so read the backend's own copy
+		const auto lock = acquire();
+		m_backend->positions(pos);
+	}
 	else
 	{
-		throw std::exception("Not initialised.");
+		throw std::runtime_error("Not initialised.");
 	}
 }
 
 
+#ifndef HEADLESS
 void Stars::draw()
 {
+	if (m_headless) throw std::runtime_error("Headless stars have no VBOs.");
+
 	if (m_initialised)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glVertexPointer(4, GL_FLOAT, 0, nullptr);
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbos[m_vbo_draw]);
+
+		switch (m_packing)
+		{
+		case Backend::Packing::HALF:
+			glVertexPointer(4, GL_HALF_FLOAT, 0, nullptr);
+			break;
+
+		case Backend::Packing::SNORM16:
+			glScalef(1.0f / Backend::snorm16_scale, 1.0f / Backend::snorm16_scale, 1.0f / Backend::snorm16_scale);
+			glVertexPointer(4, GL_SHORT, 0, nullptr);
+			break;
+
+		default:
+			glVertexPointer(4, GL_FLOAT, 0, nullptr);
+			break;
+		}
+
 		glEnableClientState(GL_VERTEX_ARRAY);
 		glColor3f(1.0f, 1.0f, 0.0f);
 		glDrawArrays(GL_POINTS, 0, m_num);
 		glDisableClientState(GL_VERTEX_ARRAY);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glPopMatrix();
+	}
+	else
+	{
+		throw std::runtime_error("Not initialised.");
+	}
+}
+#endif
+
+
+GLsizei Stars::get_num() const
+{
+	return m_num;
+}
+
+
+void Stars::set_settings(const Settings& settings)
+{
+	const auto lock = acquire();
+	m_settings = settings;
+}
+
+
+const Settings& Stars::get_settings() const
+{
+	return m_settings;
+}
+
+
+void Stars::set_backend(Backend::Kind kind)
+{
+	const auto lock = acquire();
+	m_backend_kind = kind;
+
+	if (m_initialised && (m_backend->kind() != kind))
+		restart_backend();
+}
+
+
+Backend::Kind Stars::get_backend() const
+{
+	return m_backend ? m_backend->kind() : m_backend_kind;
+}
+
+
+void Stars::set_precision(Backend::Precision precision)
+{
+	const auto lock = acquire();
+
+	if (precision != m_precision)
+	{
+		m_precision = precision;
+
+		if (m_initialised)
+			restart_backend();
+	}
+}
+
+
+Backend::Precision Stars::get_precision() const
+{
+	return m_precision;
+}
+
+
+void Stars::set_packing(Backend::Packing packing)
+{
+#ifndef HEADLESS
+	// half-float vertices need OpenGL 3.0 or ARB_half_float_vertex
+	if ((packing == Backend::Packing::HALF) && !GLEW_VERSION_3_0 && !GLEW_ARB_half_float_vertex)
+		return;
+#endif
+
+	const auto lock = acquire();
+
+	if (packing != m_packing)
+	{
+		m_packing = packing;
+
+		if (m_initialised)
+			restart_backend();
+	}
+}
+
+
+Backend::Packing Stars::get_packing() const
+{
+	return m_packing;
+}
+
+
+bool Stars::is_host() const
+{
+	return (get_backend() == Backend::Kind::HOST_SIMD) || (get_backend() == Backend::Kind::HOST_TREE);
+}
+
+
+unsigned Stars::get_reorder_count() const
+{
+	const auto lock = acquire();
+	return m_backend ? m_backend->get_reorder_count() : 0;
+}
+
+
+double Stars::get_reorder_time() const
+{
+	const auto lock = acquire();
+	return m_backend ? m_backend->get_reorder_time() : 0.0;
+}
+
+
+void Stars::tune(std::ostream& out)
+{
+	if (m_initialised)
+	{
+		const auto lock = acquire();
+		m_backend->tune(m_settings, out);
 	}
 	else
 	{
-		throw std::exception("Not initialised.");
+		throw std::runtime_error("Not initialised.");
 	}
 }
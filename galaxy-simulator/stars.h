@@ -15,42 +15,80 @@
 #ifndef STARS_H
 #define STARS_H
 
-#include <GL/glew.h>
-#include <GL/freeglut.h>
-#include <CL/opencl.h>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include "backend.h"
+#include "opengl.h"
+#include "settings.h"
+#include "snapshots.h"
+#include "vector4d.h"
 
 class Stars
 {
 private:
-	struct Vector4D
-	{
-		GLfloat x;
-		GLfloat y;
-		GLfloat z;
-		GLfloat w;
-	};
+	static const size_t num_vbos = 3;
 
 	const GLsizei m_num;
+	const unsigned m_seed;
 
 	bool m_initialised;
-	GLuint m_vbo;
-	std::unique_ptr<Vector4D[]> m_vel;
-	cl_context m_ocl_context;
-	cl_command_queue m_ocl_cmd_queue;
-	cl_kernel m_ocl_kernel;
-	cl_mem m_ocl_buffer_pos;
-	cl_mem m_ocl_buffer_vel;
-	cl_mem m_ocl_buffer_acc;
+	bool m_headless;
+	GLuint m_vbos[num_vbos];
+	size_t m_vbo_draw;
+	Settings m_settings;
+	Backend::Kind m_backend_kind;
+	Backend::Precision m_precision;
+	Backend::Packing m_packing;
+	std::unique_ptr<Backend> m_backend;
+	mutable std::mutex m_mutex;
+	mutable std::condition_variable m_handover;
+	mutable std::atomic<unsigned> m_waiting;
+	std::thread m_thread;
+	std::atomic<bool> m_simulating;
+	std::atomic<bool> m_failed;
+	std::atomic<bool> m_stepped;
+	std::exception_ptr m_error;
+	std::unique_ptr<Snapshots> m_snapshots;
 
+	std::unique_lock<std::mutex> acquire() const;
 	void release();
+	void fill_vbos(const Vector4D* pos);
+	void start_backend(const Vector4D* pos, const Vector4D* vel);
+	void restart_backend();
+	void simulate(double rate, unsigned steps);
 
 public:
-	Stars(GLulong num);
+	Stars(GLulong num, unsigned seed = 0);
 	~Stars();
-	void init();
-	void calculate();
+	void init(bool headless = false);
+	void calculate(unsigned steps = 1);
+	void finish();
+	void start_simulation(double rate, unsigned steps = 1);
+	void stop_simulation();
+#ifndef HEADLESS
+	void update();
 	void draw();
+#endif
+	void accelerations(Vector4D* acc);
+	void positions(Vector4D* pos);
+	GLsizei get_num() const;
+	void set_settings(const Settings& settings);
+	const Settings& get_settings() const;
+	void set_backend(Backend::Kind kind);
+	Backend::Kind get_backend() const;
+	void set_precision(Backend::Precision precision);
+	Backend::Precision get_precision() const;
+	void set_packing(Backend::Packing packing);
+	Backend::Packing get_packing() const;
+	bool is_host() const;
+	unsigned get_reorder_count() const;
+	double get_reorder_time() const;
+	void tune(std::ostream& out);
 };
 
 #endif
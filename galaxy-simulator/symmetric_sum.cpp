@@ -0,0 +1,277 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "symmetric_sum.h"
+#include "direct_sum.h"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+#include <limits>
+
+#ifdef _MSC_VER
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+static const double fixed_scale = 4294967296.0; // 32 fractional bits
+
+
+// the cast is undefined outside the int64 range, so each term saturates at a limit that keeps the sum of all terms in range too
+static std::int64_t to_fixed(float value, double limit)
+{
+	return static_cast<std::int64_t>(std::max(-limit, std::min(value * fixed_scale, limit)));
+}
+
+
+Symmetric_sum::Symmetric_sum() :
+	m_pool(Thread_pool::shared()),
+	m_avx2(Direct_sum::best_isa() != Direct_sum::Isa::SCALAR),
+	m_sums(m_pool.num_workers())
+{
+}
+
+
+void Symmetric_sum::tile(const float* x, const float* y, const float* z, size_t begin_i, size_t end_i, size_t begin_j, size_t end_j,
+	const Settings& settings, bool avx2, double limit, std::int64_t* sum)
+{
+	// the j tile is copied so the vector loop can run past its end over zeros
+	alignas(32) float pos_j[3][m_tile] = {};
+	alignas(32) float acc_j[3][m_tile] = {};
+	float acc_i[3][m_tile] = {};
+
+	const size_t num_j = end_j - begin_j;
+	std::copy(x + begin_j, x + end_j, pos_j[0]);
+	std::copy(y + begin_j, y + end_j, pos_j[1]);
+	std::copy(z + begin_j, z + end_j, pos_j[2]);
+
+	if (avx2)
+	{
+		tile_avx2(x, y, z, begin_i, end_i, pos_j, num_j, begin_i == begin_j, settings, acc_i, acc_j);
+	}
+	else
+	{
+		tile_scalar(x, y, z, begin_i, end_i, pos_j, num_j, begin_i == begin_j, settings, acc_i, acc_j);
+	}
+
+	for (size_t i = begin_i; i < end_i; i++)
+	{
+		for (size_t k = 0; k < 3; k++)
+		{
+			sum[3 * i + k] += to_fixed(acc_i[k][i - begin_i], limit);
+		}
+	}
+
+	for (size_t j = begin_j; j < end_j; j++)
+	{
+		for (size_t k = 0; k < 3; k++)
+		{
+			sum[3 * j + k] += to_fixed(acc_j[k][j - begin_j], limit);
+		}
+	}
+}
+
+
+void Symmetric_sum::tile_scalar(const float* x, const float* y, const float* z, size_t begin_i, size_t end_i,
+	const float (*pos_j)[m_tile], size_t num_j, bool diagonal, const Settings& settings, float (*acc_i)[m_tile], float (*acc_j)[m_tile])
+{
+	for (size_t i = begin_i; i < end_i; i++)
+	{
+		const float xi = x[i];
+		const float yi = y[i];
+		const float zi = z[i];
+
+		float ax = 0.0f;
+		float ay = 0.0f;
+		float az = 0.0f;
+
+		for (size_t j = diagonal ? (i - begin_i + 1) : 0; j < num_j; j++)
+		{
+			const float dx = pos_j[0][j] - xi;
+			const float dy = pos_j[1][j] - yi;
+			const float dz = pos_j[2][j] - zi;
+			const float r = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+			const float coef = (r > settings.radius) ? (settings.mass / r / r / r) : -settings.repulsion;
+
+			ax += coef * dx;
+			ay += coef * dy;
+			az += coef * dz;
+
+			acc_j[0][j] -= coef * dx;
+			acc_j[1][j] -= coef * dy;
+			acc_j[2][j] -= coef * dz;
+		}
+
+		acc_i[0][i - begin_i] = ax;
+		acc_i[1][i - begin_i] = ay;
+		acc_i[2][i - begin_i] = az;
+	}
+}
+
+
+SIMD_TARGET("avx2,fma")
+static float horizontal_sum(__m256 value)
+{
+	const __m128 half = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+	const __m128 pair = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+}
+
+
+SIMD_TARGET("avx2,fma")
+void Symmetric_sum::tile_avx2(const float* x, const float* y, const float* z, size_t begin_i, size_t end_i,
+	const float (*pos_j)[m_tile], size_t num_j, bool diagonal, const Settings& settings, float (*acc_i)[m_tile], float (*acc_j)[m_tile])
+{
+	const __m256 mass = _mm256_set1_ps(settings.mass);
+	const __m256 radius = _mm256_set1_ps(settings.radius);
+	const __m256 repulsion = _mm256_set1_ps(-settings.repulsion);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i count = _mm256_set1_epi32(static_cast<int>(num_j));
+
+	for (size_t i = begin_i; i < end_i; i++)
+	{
+		// lanes at or below the diagonal and past the end of the tile are masked out
+		const size_t local = i - begin_i;
+		const __m256i lowest = _mm256_set1_epi32(diagonal ? static_cast<int>(local) : -1);
+
+		const __m256 xi = _mm256_set1_ps(x[i]);
+		const __m256 yi = _mm256_set1_ps(y[i]);
+		const __m256 zi = _mm256_set1_ps(z[i]);
+
+		__m256 ax = _mm256_setzero_ps();
+		__m256 ay = _mm256_setzero_ps();
+		__m256 az = _mm256_setzero_ps();
+
+		for (size_t j = diagonal ? ((local + 1) & ~static_cast<size_t>(7)) : 0; j < num_j; j += 8)
+		{
+			const __m256i index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(j)), lanes);
+			const __m256 valid = _mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpgt_epi32(index, lowest), _mm256_cmpgt_epi32(count, index)));
+
+			const __m256 dx = _mm256_sub_ps(_mm256_load_ps(pos_j[0] + j), xi);
+			const __m256 dy = _mm256_sub_ps(_mm256_load_ps(pos_j[1] + j), yi);
+			const __m256 dz = _mm256_sub_ps(_mm256_load_ps(pos_j[2] + j), zi);
+
+			const __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+			const __m256 r = _mm256_sqrt_ps(r2);
+			const __m256 newton = _mm256_div_ps(mass, _mm256_mul_ps(r2, r));
+			const __m256 coef = _mm256_and_ps(valid, _mm256_blendv_ps(repulsion, newton, _mm256_cmp_ps(r, radius, _CMP_GT_OQ)));
+
+			ax = _mm256_fmadd_ps(coef, dx, ax);
+			ay = _mm256_fmadd_ps(coef, dy, ay);
+			az = _mm256_fmadd_ps(coef, dz, az);
+
+			_mm256_store_ps(acc_j[0] + j, _mm256_fnmadd_ps(coef, dx, _mm256_load_ps(acc_j[0] + j)));
+			_mm256_store_ps(acc_j[1] + j, _mm256_fnmadd_ps(coef, dy, _mm256_load_ps(acc_j[1] + j)));
+			_mm256_store_ps(acc_j[2] + j, _mm256_fnmadd_ps(coef, dz, _mm256_load_ps(acc_j[2] + j)));
+		}
+
+		acc_i[0][local] = horizontal_sum(ax);
+		acc_i[1][local] = horizontal_sum(ay);
+		acc_i[2][local] = horizontal_sum(az);
+	}
+}
+
+
+void Symmetric_sum::accelerations(const Bodies& bodies, size_t num, const Settings& settings)
+{
+	const size_t num_workers = m_sums.size();
+	const size_t num_chunks = (num + m_chunk - 1) / m_chunk;
+
+	for (auto& sum : m_sums)
+	{
+		if (sum.size() < 3 * num) sum.resize(3 * num);
+	}
+
+	// the tiles read separate position arrays in place, interleaved positions are split into scratch arrays first
+	const bool interleaved = (bodies.x() == nullptr);
+
+	if (interleaved && (m_x.size() < num))
+	{
+		m_x.resize(num);
+		m_y.resize(num);
+		m_z.resize(num);
+	}
+
+	m_pool.run(num_chunks, [&](size_t chunk, size_t)
+	{
+		const size_t begin = chunk * m_chunk;
+		const size_t end = std::min(num, (chunk + 1) * m_chunk);
+
+		for (auto& sum : m_sums)
+		{
+			std::fill(sum.begin() + 3 * begin, sum.begin() + 3 * end, 0);
+		}
+
+		if (!interleaved) return;
+
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vector4D pos = bodies.position(i);
+			m_x[i] = pos.x;
+			m_y[i] = pos.y;
+			m_z[i] = pos.z;
+		}
+	});
+
+	const float* x = interleaved ? m_x.data() : bodies.x();
+	const float* y = interleaved ? m_y.data() : bodies.y();
+	const float* z = interleaved ? m_z.data() : bodies.z();
+
+	// upper triangle of tile pairs in row order, each pair applies Newton's third law to both of its tiles
+	const size_t num_rows = (num + m_tile - 1) / m_tile;
+	const double limit = static_cast<double>(std::numeric_limits<std::int64_t>::max() / static_cast<std::int64_t>(num_rows + 1));
+	std::vector<std::uint32_t> tiles;
+	tiles.reserve(num_rows * (num_rows + 1));
+
+	for (size_t row = 0; row < num_rows; row++)
+	{
+		for (size_t col = row; col < num_rows; col++)
+		{
+			tiles.push_back(static_cast<std::uint32_t>(row));
+			tiles.push_back(static_cast<std::uint32_t>(col));
+		}
+	}
+
+	m_pool.run(tiles.size() / 2, [&](size_t task, size_t worker)
+	{
+		const size_t row = tiles[2 * task];
+		const size_t col = tiles[2 * task + 1];
+
+		tile(x, y, z, row * m_tile, std::min(num, (row + 1) * m_tile), col * m_tile,
+			std::min(num, (col + 1) * m_tile), settings, m_avx2, limit, m_sums[worker].data());
+	});
+
+	m_pool.run(num_chunks, [&](size_t chunk, size_t)
+	{
+		const size_t end = std::min(num, (chunk + 1) * m_chunk);
+
+		for (size_t i = chunk * m_chunk; i < end; i++)
+		{
+			std::int64_t total[3] = {};
+
+			for (size_t w = 0; w < num_workers; w++)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					total[k] += m_sums[w][3 * i + k];
+				}
+			}
+
+			bodies.set_acceleration(i, { static_cast<float>(total[0] / fixed_scale), static_cast<float>(total[1] / fixed_scale),
+				static_cast<float>(total[2] / fixed_scale), 0.0f });
+		}
+	});
+}
@@ -0,0 +1,50 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYMMETRIC_SUM_H
+#define SYMMETRIC_SUM_H
+
+#include "bodies.h"
+#include "settings.h"
+#include "thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Symmetric_sum
+{
+private:
+	static const size_t m_tile = 128;
+	static const size_t m_chunk = 1024;
+
+	Thread_pool& m_pool;
+	bool m_avx2;
+	std::vector<std::vector<std::int64_t>> m_sums;
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+
+	static void tile(const float* x, const float* y, const float* z, size_t begin_i, size_t end_i, size_t begin_j, size_t end_j,
+		const Settings& settings, bool avx2, double limit, std::int64_t* sum);
+	static void tile_scalar(const float* x, const float* y, const float* z, size_t begin_i, size_t end_i,
+		const float (*pos_j)[m_tile], size_t num_j, bool diagonal, const Settings& settings, float (*acc_i)[m_tile], float (*acc_j)[m_tile]);
+	static void tile_avx2(const float* x, const float* y, const float* z, size_t begin_i, size_t end_i,
+		const float (*pos_j)[m_tile], size_t num_j, bool diagonal, const Settings& settings, float (*acc_i)[m_tile], float (*acc_j)[m_tile]);
+
+public:
+	Symmetric_sum();
+	void accelerations(const Bodies& bodies, size_t num, const Settings& settings);
+};
+
+#endif
@@ -0,0 +1,210 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "thread_pool.h"
+
+// the pool a thread is currently working for and its worker index there, so nested runs stay on that thread
+static thread_local const Thread_pool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+
+Thread_pool::Thread_pool() :
+	m_num_workers(std::thread::hardware_concurrency()),
+	m_body(nullptr),
+	m_generation(0),
+	m_num_running(0),
+	m_stop(false),
+	m_failed(false)
+{
+	if (m_num_workers == 0) m_num_workers = 1;
+
+	m_queues = std::make_unique<Queue[]>(m_num_workers);
+
+	for (size_t w = 1; w < m_num_workers; w++)
+	{
+		m_threads.emplace_back(&Thread_pool::loop, this, w);
+	}
+}
+
+
+Thread_pool::~Thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_start.notify_all();
+
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+
+Thread_pool& Thread_pool::shared()
+{
+	static Thread_pool pool;
+	return pool;
+}
+
+
+size_t Thread_pool::num_workers() const
+{
+	return m_num_workers;
+}
+
+
+bool Thread_pool::pop(size_t worker, size_t& task)
+{
+	Queue& queue = m_queues[worker];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.begin >= queue.end) return false;
+
+	task = queue.begin++;
+	return true;
+}
+
+
+bool Thread_pool::steal(size_t worker, size_t& task)
+{
+	for (size_t offset = 1; offset < m_num_workers; offset++)
+	{
+		Queue& victim = m_queues[(worker + offset) % m_num_workers];
+		size_t begin, end;
+
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (victim.begin >= victim.end) continue;
+
+			// take the back half, the victim keeps working from the front
+			begin = victim.begin + (victim.end - victim.begin) / 2;
+			end = victim.end;
+			victim.end = begin;
+		}
+
+		Queue& queue = m_queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		task = begin;
+		queue.begin = begin + 1;
+		queue.end = end;
+		return true;
+	}
+
+	return false;
+}
+
+
+void Thread_pool::work(size_t worker)
+{
+	size_t task;
+
+	current_pool = this;
+	current_worker = worker;
+
+	while (pop(worker, task) || steal(worker, task))
+	{
+		// after a failure the remaining tasks are drained without running them
+		if (m_failed) continue;
+
+		try
+		{
+			(*m_body)(task, worker);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_failed)
+			{
+				m_error = std::current_exception();
+				m_failed = true;
+			}
+		}
+	}
+
+	current_pool = nullptr;
+}
+
+
+void Thread_pool::loop(size_t worker)
+{
+	unsigned generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [&]() { return m_stop || (m_generation != generation); });
+			if (m_stop) return;
+			generation = m_generation;
+		}
+
+		work(worker);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_num_running == 0) m_done.notify_all();
+		}
+	}
+}
+
+
+void Thread_pool::run(size_t num_tasks, const std::function<void(size_t task, size_t worker)>& body)
+{
+	if (num_tasks == 0) return;
+
+	if (current_pool == this)
+	{
+		const size_t worker = current_worker;
+
+		for (size_t task = 0; task < num_tasks; task++)
+		{
+			body(task, worker);
+		}
+
+		return;
+	}
+
+	// callers on different threads take turns, the queues and the body are shared
+	std::lock_guard<std::mutex> run_lock(m_run_mutex);
+
+	for (size_t w = 0; w < m_num_workers; w++)
+	{
+		std::lock_guard<std::mutex> lock(m_queues[w].mutex);
+		m_queues[w].begin = num_tasks * w / m_num_workers;
+		m_queues[w].end = num_tasks * (w + 1) / m_num_workers;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_body = &body;
+		m_num_running = m_num_workers - 1;
+		m_failed = false;
+		m_error = nullptr;
+		m_generation++;
+	}
+
+	m_start.notify_all();
+	work(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [&]() { return m_num_running == 0; });
+	m_body = nullptr;
+
+	if (m_failed) std::rethrow_exception(m_error);
+}
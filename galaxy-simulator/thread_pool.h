@@ -0,0 +1,70 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Thread_pool
+{
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		size_t begin;
+		size_t end;
+	};
+
+	std::vector<std::thread> m_threads;
+	std::unique_ptr<Queue[]> m_queues;
+	size_t m_num_workers;
+
+	std::mutex m_run_mutex;
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+	const std::function<void(size_t task, size_t worker)>* m_body;
+	unsigned m_generation;
+	size_t m_num_running;
+	bool m_stop;
+	std::atomic<bool> m_failed;
+	std::exception_ptr m_error;
+
+	bool pop(size_t worker, size_t& task);
+	bool steal(size_t worker, size_t& task);
+	void work(size_t worker);
+	void loop(size_t worker);
+
+public:
+	Thread_pool();
+	~Thread_pool();
+	Thread_pool(const Thread_pool&) = delete;
+	Thread_pool& operator=(const Thread_pool&) = delete;
+
+	static Thread_pool& shared();
+
+	size_t num_workers() const;
+	void run(size_t num_tasks, const std::function<void(size_t task, size_t worker)>& body);
+};
+
+#endif
@@ -0,0 +1,28 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "tree_pm.h"
+
+
+void Tree_pm::accelerations(const Bodies& bodies, size_t num, const Settings& settings)
+{
+	const float split = settings.tree_pm_split * Particle_mesh::cell_size(settings);
+	const float cutoff = settings.tree_pm_cutoff * split;
+
+	m_particle_mesh.accelerations(bodies, num, settings, split);
+
+	m_octree.build(bodies, num, settings.mass);
+	m_octree.add_short_range(bodies, settings, split, cutoff);
+}
@@ -0,0 +1,34 @@
+/*
+	Copyright (C) 2019 Matej Gomboc https://github.com/MatejGomboc/Galaxy-Simulator
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as published
+	by the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version. This program is distributed in the
+	hope that it will be useful, but WITHOUT ANY WARRANTY; without even the
+	implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU Affero General Public License for more details. You should
+	have received a copy of the GNU Affero General Public License along with
+	this program. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TREE_PM_H
+#define TREE_PM_H
+
+#include "bodies.h"
+#include "octree.h"
+#include "particle_mesh.h"
+#include "settings.h"
+#include <cstddef>
+
+class Tree_pm
+{
+private:
+	Octree m_octree;
+	Particle_mesh m_particle_mesh;
+
+public:
+	void accelerations(const Bodies& bodies, size_t num, const Settings& settings);
+};
+
+#endif
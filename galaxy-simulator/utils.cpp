@@ -14,8 +14,11 @@
 
 
 #include "utils.h"
+#include "thread_pool.h"
 #include <stdexcept>
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846f
@@ -24,7 +27,7 @@
 
 float Utils::wrap(float value, const float min, const float max)
 {
-	if (min > max) throw std::exception("MIN > MAX in wrap function.");
+	if (min > max) throw std::runtime_error("MIN > MAX in wrap function.");
 	if (min == max) return min;
 
 	const float difference = max - min;
@@ -45,7 +48,7 @@ float Utils::wrap(float value, const float min, const float max)
 
 float Utils::clamp(float value, const float min, const float max)
 {
-	if (min > max) throw std::exception("MIN > MAX in clamp function.");
+	if (min > max) throw std::runtime_error("MIN > MAX in clamp function.");
 	if (min == max) return min;
 
 	if (value > max) return max;
@@ -64,3 +67,63 @@ float Utils::rad(const float value_deg)
 {
 	return(value_deg * (float)M_PI / 180.0f);
 }
+
+
+void Utils::parallel_for(const size_t count, const size_t chunk, const std::function<void(size_t begin, size_t end)>& body)
+{
+	if (chunk == 0) throw std::runtime_error("Zero chunk size in parallel_for function.");
+
+	Thread_pool::shared().run((count + chunk - 1) / chunk, [&](size_t task, size_t)
+	{
+		const size_t begin = task * chunk;
+		body(begin, (begin + chunk < count) ? (begin + chunk) : count);
+	});
+}
+
+
+void Utils::radix_sort(const std::uint32_t* keys, const size_t count, std::int32_t* order)
+{
+	std::vector<std::int32_t> temp(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		order[i] = static_cast<std::int32_t>(i);
+	}
+
+	for (unsigned shift = 0; shift < 32; shift += 8)
+	{
+		size_t offset[257] = { 0 };
+
+		for (size_t i = 0; i < count; i++)
+		{
+			offset[((keys[i] >> shift) & 0xff) + 1]++;
+		}
+
+		for (int b = 0; b < 256; b++)
+		{
+			offset[b + 1] += offset[b];
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			temp[offset[(keys[order[i]] >> shift) & 0xff]++] = order[i];
+		}
+
+		std::copy(temp.begin(), temp.end(), order);
+	}
+}
+
+
+std::uint64_t Utils::hash(const std::string& data)
+{
+	// 64-bit FNV-1a
+	std::uint64_t value = 14695981039346656037ull;
+
+	for (const char c : data)
+	{
+		value ^= static_cast<unsigned char>(c);
+		value *= 1099511628211ull;
+	}
+
+	return value;
+}
@@ -15,6 +15,11 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
 class Utils
 {
 private:
@@ -26,6 +31,9 @@ public:
 	static float clamp(const float value, const float min, const float max);
 	static float deg(const float value_rad);
 	static float rad(const float value_deg);
+	static void parallel_for(const size_t count, const size_t chunk, const std::function<void(size_t begin, size_t end)>& body);
+	static void radix_sort(const std::uint32_t* keys, const size_t count, std::int32_t* order);
+	static std::uint64_t hash(const std::string& data);
 };
 
 #endif